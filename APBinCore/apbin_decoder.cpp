@@ -0,0 +1,3310 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ * 
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * This decode ArduPilot DataFlash binaries without any dependency on Qt or PlotJuggler (see apbin_decoder.h).
+ * The logic is derived from Dronekit-La software (https://github.com/dronekit/dronekit-la).
+ *
+ */
+
+#include "apbin_decoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+// Debugging 
+//#define DEBUG_RUNTIME
+//#define DEBUG_MESSAGES
+//#define DEBUG_MULTIPLIERS
+//#define DEBUG_UNITS
+
+
+// Config
+//#define LABEL_WITH_UNIT
+//#define DIRECT_PUBLISH    // always publish the decoded samples directly, not only for logfiles which exceed the memory
+
+
+bool is_nearly(double val, int val2)
+{
+  const double epsilon = 1e-10;
+  if (std::abs(val - val2) < epsilon)
+  {
+    return true;
+  }
+  else
+  {
+    return false;
+  }
+}
+
+
+// Already parsed regions of the mapped logfile are handed back to the kernel in steps of this size,
+// so the resident size of a multi-GB logfile stays bounded while decoding.
+static constexpr uint64_t MAPPED_RELEASE_STEP = 64 * 1024 * 1024;
+
+
+// hint the kernel that the mapped logfile is read front to back (aggressive read-ahead)
+static void advise_sequential(const uint8_t* buf, uint64_t len)
+{
+  #if defined(__unix__) || defined(__APPLE__)
+    madvise(const_cast<uint8_t*>(buf), len, MADV_SEQUENTIAL);
+  #else
+    (void)buf;
+    (void)len;
+  #endif
+}
+
+
+// drop the clean pages of an already parsed region [begin, end) of the mapped logfile
+static void release_mapped_region(const uint8_t* buf, uint64_t begin, uint64_t end)
+{
+  #if defined(__unix__) || defined(__APPLE__)
+    // madvise() needs a page aligned start address, round the region inwards
+    const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t aligned_begin = (begin + page_size - 1) / page_size * page_size;
+    const uint64_t aligned_end = end / page_size * page_size;
+    if (aligned_end > aligned_begin)
+    {
+      madvise(const_cast<uint8_t*>(buf + aligned_begin), aligned_end - aligned_begin, MADV_DONTNEED);
+    }
+  #else
+    (void)buf;
+    (void)begin;
+    (void)end;
+  #endif
+}
+
+
+// get the size of the physical memory in bytes (0, if unknown)
+static uint64_t get_physical_memory_size(void)
+{
+  #if defined(__unix__) || defined(__APPLE__)
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0)
+    {
+      return static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size);
+    }
+  #endif
+  return 0;
+}
+
+
+// find the next message start sequence (HEAD_BYTE1, HEAD_BYTE2) in the logfile
+//  - returns the byte-offset of the first header in [begin, end) or end, if there is none
+//  - buf[end] must be readable, because the second header byte of a candidate at end - 1 is checked
+//  - corrupted or padded regions are skipped with vector instructions (if available) instead of byte by byte
+static uint64_t find_next_header(const uint8_t* buf, uint64_t begin, const uint64_t end)
+{
+  #if defined(__AVX2__)
+    const __m256i head1 = _mm256_set1_epi8(static_cast<char>(HEAD_BYTE1));
+    const __m256i head2 = _mm256_set1_epi8(static_cast<char>(HEAD_BYTE2));
+    while (begin + 32 <= end)
+    {
+      // bit i is set, if buf[begin + i] and buf[begin + i + 1] are a message start sequence
+      const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf + begin));
+      const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf + begin + 1));
+      const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+          _mm256_and_si256(_mm256_cmpeq_epi8(first, head1), _mm256_cmpeq_epi8(second, head2))));
+      if (mask != 0)
+      {
+        return begin + __builtin_ctz(mask);
+      }
+      begin += 32;
+    }
+  #elif defined(__SSE2__)
+    const __m128i head1 = _mm_set1_epi8(static_cast<char>(HEAD_BYTE1));
+    const __m128i head2 = _mm_set1_epi8(static_cast<char>(HEAD_BYTE2));
+    while (begin + 16 <= end)
+    {
+      // bit i is set, if buf[begin + i] and buf[begin + i + 1] are a message start sequence
+      const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + begin));
+      const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + begin + 1));
+      const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+          _mm_and_si128(_mm_cmpeq_epi8(first, head1), _mm_cmpeq_epi8(second, head2))));
+      if (mask != 0)
+      {
+        return begin + __builtin_ctz(mask);
+      }
+      begin += 16;
+    }
+  #endif
+
+  // remaining bytes (or no vector instructions available): memchr for the first header byte
+  while (begin < end)
+  {
+    const void* found = memchr(buf + begin, HEAD_BYTE1, end - begin);
+    if (found == nullptr)
+    {
+      return end;
+    }
+    begin = static_cast<const uint8_t*>(found) - buf;
+    if (buf[begin + 1] == HEAD_BYTE2)
+    {
+      return begin;
+    }
+    begin++;
+  }
+  return end;
+}
+
+
+
+// find the minimum and the maximum of values[begin, end), NaN values are not part of them
+//  - returns true, if there is a NaN value in the range
+//  - min_value is +inf and max_value is -inf, if there is no other value
+//  - only the values are reduced (with vector instructions, if available), the rows are searched afterwards (see find_row)
+static bool find_extremes(const double* values, size_t begin, const size_t end, double& min_value, double& max_value)
+{
+  min_value = std::numeric_limits<double>::infinity();
+  max_value = -std::numeric_limits<double>::infinity();
+  bool has_nan = false;
+
+  // min and max return their second operand, if a value is NaN, so a NaN never replaces an extreme
+  //  - two independent accumulators, so a block does not wait for the result of the previous one
+  //  - an unordered compare of the two blocks of an iteration is true, if one of them is NaN
+  #if defined(__AVX2__)
+    __m256d min_lanes[2] = { _mm256_set1_pd(min_value), _mm256_set1_pd(min_value) };
+    __m256d max_lanes[2] = { _mm256_set1_pd(max_value), _mm256_set1_pd(max_value) };
+    __m256d nan_lanes = _mm256_setzero_pd();
+    while (begin + 8 <= end)
+    {
+      const __m256d first = _mm256_loadu_pd(values + begin);
+      const __m256d second = _mm256_loadu_pd(values + begin + 4);
+      min_lanes[0] = _mm256_min_pd(first, min_lanes[0]);
+      min_lanes[1] = _mm256_min_pd(second, min_lanes[1]);
+      max_lanes[0] = _mm256_max_pd(first, max_lanes[0]);
+      max_lanes[1] = _mm256_max_pd(second, max_lanes[1]);
+      nan_lanes = _mm256_or_pd(nan_lanes, _mm256_cmp_pd(first, second, _CMP_UNORD_Q));
+      begin += 8;
+    }
+    double min_block[8];
+    double max_block[8];
+    _mm256_storeu_pd(min_block, min_lanes[0]);
+    _mm256_storeu_pd(min_block + 4, min_lanes[1]);
+    _mm256_storeu_pd(max_block, max_lanes[0]);
+    _mm256_storeu_pd(max_block + 4, max_lanes[1]);
+    for (int lane = 0; lane < 8; lane++)
+    {
+      min_value = std::min(min_value, min_block[lane]);
+      max_value = std::max(max_value, max_block[lane]);
+    }
+    has_nan = ( _mm256_movemask_pd(nan_lanes) != 0 );
+  #elif defined(__SSE2__)
+    __m128d min_lanes[2] = { _mm_set1_pd(min_value), _mm_set1_pd(min_value) };
+    __m128d max_lanes[2] = { _mm_set1_pd(max_value), _mm_set1_pd(max_value) };
+    __m128d nan_lanes = _mm_setzero_pd();
+    while (begin + 4 <= end)
+    {
+      const __m128d first = _mm_loadu_pd(values + begin);
+      const __m128d second = _mm_loadu_pd(values + begin + 2);
+      min_lanes[0] = _mm_min_pd(first, min_lanes[0]);
+      min_lanes[1] = _mm_min_pd(second, min_lanes[1]);
+      max_lanes[0] = _mm_max_pd(first, max_lanes[0]);
+      max_lanes[1] = _mm_max_pd(second, max_lanes[1]);
+      nan_lanes = _mm_or_pd(nan_lanes, _mm_cmpunord_pd(first, second));
+      begin += 4;
+    }
+    double min_block[4];
+    double max_block[4];
+    _mm_storeu_pd(min_block, min_lanes[0]);
+    _mm_storeu_pd(min_block + 2, min_lanes[1]);
+    _mm_storeu_pd(max_block, max_lanes[0]);
+    _mm_storeu_pd(max_block + 2, max_lanes[1]);
+    for (int lane = 0; lane < 4; lane++)
+    {
+      min_value = std::min(min_value, min_block[lane]);
+      max_value = std::max(max_value, max_block[lane]);
+    }
+    has_nan = ( _mm_movemask_pd(nan_lanes) != 0 );
+  #endif
+
+  // remaining values (or no vector instructions available)
+  for (; begin < end; begin++)
+  {
+    const double value = values[begin];
+    min_value = (value < min_value) ? value : min_value;
+    max_value = (value > max_value) ? value : max_value;
+    has_nan = has_nan || std::isnan(value);
+  }
+  return has_nan;
+}
+
+
+
+// find the first row in [begin, end) with the given value (not NaN), returns end if there is none
+static size_t find_row(const double* values, size_t begin, const size_t end, const double value)
+{
+  #if defined(__AVX2__)
+    const __m256d wanted = _mm256_set1_pd(value);
+    while (begin + 4 <= end)
+    {
+      const int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + begin), wanted, _CMP_EQ_OQ));
+      if ( mask != 0 )
+      {
+        return begin + __builtin_ctz(mask);
+      }
+      begin += 4;
+    }
+  #elif defined(__SSE2__)
+    const __m128d wanted = _mm_set1_pd(value);
+    while (begin + 2 <= end)
+    {
+      const int mask = _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(values + begin), wanted));
+      if ( mask != 0 )
+      {
+        return begin + __builtin_ctz(mask);
+      }
+      begin += 2;
+    }
+  #endif
+
+  // remaining values (or no vector instructions available)
+  for (; begin < end && !(values[begin] == value); begin++) {}
+  return begin;
+}
+
+
+// FNV-1a hash of a byte range (identity of the logfile for resuming a load)
+static uint64_t hash_bytes(const uint8_t* buf, const uint64_t& len)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (uint64_t i = 0; i < len; i++)
+  {
+    hash = (hash ^ buf[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+
+// milliseconds since the given point in time, the measurement restarts at the current time
+static double take_elapsed_ms(std::chrono::steady_clock::time_point& since)
+{
+  const auto now = std::chrono::steady_clock::now();
+  const double elapsed_ms = std::chrono::duration<double, std::milli>(now - since).count();
+  since = now;
+  return elapsed_ms;
+}
+
+
+// producer of the buffers of a streamed logfile
+//  - a thread reads the source into a ring of buffers, while the thread of the load parses the filled ones in order
+//  - each buffer has room for carry bytes in front of its data (see APBinDecoder::parse_stream)
+//  - a failure of the producer thread (e.g. std::bad_alloc) ends the stream, next rethrows it on the thread of the load
+class StreamProducer
+{
+public:
+  struct buffer
+  {
+    std::vector<uint8_t> memory;
+    size_t size = 0;          // number of bytes read (behind the carry room)
+    bool last = false;        // indicator, if the source has no more data behind this buffer
+    uint64_t position = 0;    // position of the source after this buffer (see APBinSource::get_position)
+    std::string error;        // failure of the source, which ended the stream (only in the last buffer)
+  };
+
+  StreamProducer(APBinSource& source, const size_t& buffer_size, const size_t& buffer_count, const size_t& carry)
+    : source(source), buffer_size(buffer_size), carry(carry), buffers(buffer_count)
+  {
+    for (auto& buf : buffers)
+    {
+      free_buffers.push_back(&buf);
+    }
+    producer = std::thread(&StreamProducer::produce, this);
+  }
+
+  ~StreamProducer()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopped = true;
+    }
+    changed.notify_all();
+    producer.join();
+  }
+
+  // wait for the next filled buffer
+  buffer* next(void)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return !filled_buffers.empty() || error; });
+    if ( error )
+    {
+      std::rethrow_exception(error);
+    }
+    buffer* buf = filled_buffers.front();
+    filled_buffers.pop_front();
+    return buf;
+  }
+
+  // hand a parsed buffer back to the producer
+  void release(buffer* buf)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      free_buffers.push_back(buf);
+    }
+    changed.notify_all();
+  }
+
+private:
+  APBinSource& source;
+  const size_t buffer_size;
+  const size_t carry;
+  std::vector<buffer> buffers;
+  std::deque<buffer*> free_buffers;
+  std::deque<buffer*> filled_buffers;
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool stopped = false;
+  std::exception_ptr error;   // failure of the producer thread
+  std::thread producer;
+
+
+  void produce(void)
+  {
+    try
+    {
+      fill_buffers();
+    }
+    catch (...)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = std::current_exception();
+      }
+      changed.notify_all();
+    }
+  }
+
+  void fill_buffers(void)
+  {
+    bool last = false;
+    while ( !last )
+    {
+      buffer* buf = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return stopped || !free_buffers.empty(); });
+        if ( stopped )
+        {
+          return;
+        }
+        buf = free_buffers.front();
+        free_buffers.pop_front();
+      }
+
+      // the buffer is filled completely, unless the source ends
+      buf->memory.resize(carry + buffer_size);
+      buf->size = 0;
+      while ( buf->size < buffer_size && !last )
+      {
+        const size_t bytes = source.read(buf->memory.data() + carry + buf->size, buffer_size - buf->size);
+        buf->size += bytes;
+        last = (bytes == 0);
+      }
+      buf->last = last;
+      buf->position = source.get_position();
+      buf->error = last ? source.get_error() : std::string();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        filled_buffers.push_back(buf);
+      }
+      changed.notify_all();
+    }
+  }
+};
+
+
+
+// match a name against a single wildcard pattern ('*', '?' and '[...]', the whole name must match)
+static bool matches_pattern(const std::string& pattern, const std::string& name)
+{
+  size_t p = 0;
+  size_t n = 0;
+  size_t star_p = std::string::npos;    // position behind the last '*' in the pattern
+  size_t star_n = 0;                    // position in the name, at which the last '*' continues
+
+  while (n < name.size())
+  {
+    bool matched = false;
+    size_t next_p = p + 1;
+    if ( p < pattern.size() && pattern[p] == '*' )
+    {
+      star_p = ++p;
+      star_n = n;
+      continue;
+    }
+    else if ( p < pattern.size() && pattern[p] == '?' )
+    {
+      matched = true;
+    }
+    else if ( p < pattern.size() && pattern[p] == '[' )
+    {
+      // character set, e.g. [A-C] or [^0-9] ('!' negates as well)
+      size_t q = p + 1;
+      const bool negated = ( q < pattern.size() && (pattern[q] == '^' || pattern[q] == '!') );
+      q += negated ? 1 : 0;
+      bool in_set = false;
+      bool first = true;
+      while ( q < pattern.size() && (pattern[q] != ']' || first) )
+      {
+        if ( q + 2 < pattern.size() && pattern[q + 1] == '-' && pattern[q + 2] != ']' )
+        {
+          in_set = in_set || (name[n] >= pattern[q] && name[n] <= pattern[q + 2]);
+          q += 3;
+        }
+        else
+        {
+          in_set = in_set || (name[n] == pattern[q]);
+          q++;
+        }
+        first = false;
+      }
+      if ( q < pattern.size() )
+      {
+        matched = (in_set != negated);
+        next_p = q + 1;
+      }
+      else
+      {
+        // unterminated set: '[' is a normal character
+        matched = (name[n] == '[');
+      }
+    }
+    else if ( p < pattern.size() )
+    {
+      matched = (pattern[p] == name[n]);
+    }
+
+    if ( matched )
+    {
+      p = next_p;
+      n++;
+    }
+    else if ( star_p != std::string::npos )
+    {
+      // let the last '*' take one more character
+      p = star_p;
+      n = ++star_n;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  // trailing '*' match the empty rest of the name
+  while ( p < pattern.size() && pattern[p] == '*' )
+  {
+    p++;
+  }
+  return p == pattern.size();
+}
+
+
+
+bool APBinDecoder::has_unit_labels(void)
+{
+  #ifdef LABEL_WITH_UNIT
+    return true;
+  #else
+    return false;
+  #endif
+}
+
+
+
+bool APBinDecoder::matches(const std::vector<std::string>& patterns, const std::string& name)
+{
+  for (const std::string& pattern : patterns)
+  {
+    if ( matches_pattern(pattern, name) )
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+
+bool APBinDecoder::decode(const uint8_t* buf, const uint64_t& len, APBinSink& sink, load_hooks& hooks, load_report& report)
+{
+  advise_sequential(buf, len);
+  const bool decoded = decode_logfile(buf, len, nullptr, sink, hooks, report);
+
+  // a cancel only stops the running load
+  cancel_requested = false;
+  return decoded;
+}
+
+
+
+bool APBinDecoder::decode(APBinSource& source, APBinSink& sink, load_hooks& hooks, load_report& report)
+{
+  const bool decoded = decode_logfile(nullptr, 0, &source, sink, hooks, report);
+
+  // a cancel only stops the running load
+  cancel_requested = false;
+  return decoded;
+}
+
+
+
+bool APBinDecoder::can_resume(const uint8_t* buf, const uint64_t& len) const
+{
+  if ( !resumable || len < resume_offset )
+  {
+    return false;
+  }
+
+  // the logfile must still start with the bytes of the last load (the beginning and the bytes in front of the resume point)
+  const uint64_t head_size = std::min(resume_offset, RESUME_HASH_SIZE);
+  const uint64_t tail_begin = resume_offset - head_size;
+  return hash_bytes(buf, head_size) == resume_head_hash &&
+         hash_bytes(buf + tail_begin, head_size) == resume_tail_hash;
+}
+
+
+
+bool APBinDecoder::resume(const uint8_t* buf, const uint64_t& len, APBinSink& sink, load_report& report)
+{
+  report = load_report();
+  report.bytes = len - resume_offset;
+  auto phase_start = std::chrono::steady_clock::now();
+
+  // the appended messages continue the definitions and the message_data of the last load
+  parse_context ctx;
+  ctx.pass = parse_pass::DECODE;
+  ctx.begin = resume_offset;
+  ctx.end = len;
+  ctx.bytes_parsed = &pass_bytes;
+  begin_pass_progress(0, 100, len - resume_offset);
+  resuming = true;
+  const bool parsed = parse_messages(buf, len, ctx);
+  resuming = false;
+  cancel_requested = false;
+  if ( !parsed )
+  {
+    // a part of the appended messages is already stored, only a full load is consistent again
+    resumable = false;
+    return false;
+  }
+  report.decode_ms = take_elapsed_ms(phase_start);
+  build_profile(ctx.stats, report.profile);
+
+  // units of appended UNIT messages, the timesync, if the last load did not contain enough GNSS data
+  process_units();
+  if ( !time_offset_folded )
+  {
+    apply_timesync();
+  }
+  report.postprocess_ms = take_elapsed_ms(phase_start);
+
+  // all series are published again, the caller replaces the series of the last load
+  publish_messages(sink);
+  report.publish_ms = take_elapsed_ms(phase_start);
+  report.bytes_skipped = ctx.stats.bytes_skipped;
+  report.msgs_skipped = ctx.stats.msgs_skipped;
+  report.msgs_read = ctx.stats.msgs_read;
+
+  record_resume_point(buf, ctx.parsed);
+  return true;
+}
+
+
+
+void APBinDecoder::record_resume_point(const uint8_t* buf, const uint64_t& offset)
+{
+  const uint64_t head_size = std::min(offset, RESUME_HASH_SIZE);
+  resume_offset = offset;
+  resume_head_hash = hash_bytes(buf, head_size);
+  resume_tail_hash = hash_bytes(buf + offset - head_size, head_size);
+  resumable = true;
+}
+
+
+
+void APBinDecoder::release_decoded_data(void)
+{
+  for (auto& instances : messages_store)
+  {
+    instances.reset();
+  }
+  retired_messages.clear();
+  resumable = false;
+}
+
+
+
+void APBinDecoder::begin_live(void)
+{
+  // the decoder is reused for every logfile, start from a clean state
+  reset_definitions();
+  for (auto& instances : messages_store)
+  {
+    instances.reset();
+  }
+  retired_messages.clear();
+  for (auto& instances : series_store)
+  {
+    instances.reset();
+  }
+
+  // there is no pre-scan, the patterns of the selection are applied when the FMT of a message arrives
+  selection_active = true;
+  multipliers_folded = true;
+  for (auto& scales : field_scales)
+  {
+    std::fill(std::begin(scales), std::end(scales), 1.0);
+  }
+  time_offset_folded = false;
+  has_gps_reference = false;
+  gps_reference_msg.clear();
+  time_index.clear();
+  message_counts.clear();
+  decode_chunks.clear();
+  decode_chunk_size = 0;
+
+  resumable = false;
+  live_decoding = true;
+  live_buffer.clear();
+  live_offset = 0;
+  live_stats = parse_statistics();
+}
+
+
+
+uint64_t APBinDecoder::decode_live(const uint8_t* buf, const size_t& len, APBinSink& sink)
+{
+  // the appended bytes continue the incomplete message of the previous call
+  live_buffer.insert(live_buffer.end(), buf, buf + len);
+
+  std::atomic<uint64_t> bytes_parsed{ 0 };
+  parse_context ctx;
+  ctx.pass = parse_pass::LIVE;
+  ctx.end = live_buffer.size();
+  ctx.mapped = false;
+  ctx.base = live_offset;
+  ctx.more_input = true;
+  ctx.sink = &sink;
+  ctx.bytes_parsed = &bytes_parsed;
+  parse_messages(live_buffer.data(), live_buffer.size(), ctx);
+
+  live_buffer.erase(live_buffer.begin(), live_buffer.begin() + ctx.parsed);
+  live_offset += ctx.parsed;
+  merge_statistics(live_stats, ctx.stats);
+  return ctx.stats.msgs_read;
+}
+
+
+
+void APBinDecoder::get_live_report(load_report& report) const
+{
+  report = load_report();
+  report.bytes = live_offset;
+  report.bytes_skipped = live_stats.bytes_skipped;
+  report.msgs_read = live_stats.msgs_read;
+  report.msgs_skipped = live_stats.msgs_skipped;
+  report.direct_publish = true;
+  build_profile(live_stats, report.profile);
+}
+
+
+
+// quote a string for JSON
+static std::string json_string(const std::string& value)
+{
+  std::string quoted = "\"";
+  for (const char c : value)
+  {
+    if ( c == '"' || c == '\\' )
+    {
+      quoted += '\\';
+      quoted += c;
+    }
+    else if ( static_cast<unsigned char>(c) < 0x20 )
+    {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      quoted += escaped;
+    }
+    else
+    {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+
+
+std::string APBinDecoder::load_report::to_json(void) const
+{
+  std::string json;
+  char line[512];
+
+  std::snprintf(line, sizeof(line),
+                "{\n  \"bytes\": %" PRIu64 ",\n  \"bytes_skipped\": %" PRIu64 ",\n  \"msgs_read\": %" PRIu32 ",\n"
+                "  \"msgs_skipped\": %" PRIu32 ",\n  \"msgs_outside_window\": %" PRIu32 ",\n  \"parallel\": %s,\n"
+                "  \"direct_publish\": %s,\n",
+                bytes, bytes_skipped, msgs_read, msgs_skipped, msgs_outside_window, parallel ? "true" : "false",
+                direct_publish ? "true" : "false");
+  json += line;
+  std::snprintf(line, sizeof(line),
+                "  \"phases_ms\": { \"prescan\": %.3f, \"decode\": %.3f, \"postprocess\": %.3f, \"publish\": %.3f },\n",
+                prescan_ms, decode_ms, postprocess_ms, publish_ms);
+  json += line;
+  std::snprintf(line, sizeof(line),
+                "  \"column_bytes_allocated\": %" PRIu64 ",\n  \"column_bytes_peak\": %" PRIu64 ",\n  \"start_time\": %.6f,\n",
+                profile.column_bytes_allocated, profile.column_bytes_peak, profile.start_time);
+  json += line;
+
+  json += "  \"messages\": [";
+  for (size_t idx = 0; idx < profile.messages.size(); idx++)
+  {
+    const message_profile& message = profile.messages[idx];
+    std::snprintf(line, sizeof(line),
+                  "%s\n    { \"name\": %s, \"id\": %u, \"bytes\": %" PRIu64 ", \"messages\": %" PRIu64 ", "
+                  "\"skipped\": %" PRIu64 ", \"outside_window\": %" PRIu64 ", \"decode_ms\": %.3f }",
+                  (idx == 0) ? "" : ",", json_string(message.name).c_str(), message.msg_id, message.bytes, message.messages,
+                  message.skipped, message.outside_window, message.decode_ms);
+    json += line;
+  }
+  json += profile.messages.empty() ? "],\n" : "\n  ],\n";
+
+  json += "  \"skipped_regions\": [";
+  for (size_t idx = 0; idx < profile.skipped_regions.size(); idx++)
+  {
+    const skipped_region& region = profile.skipped_regions[idx];
+    std::snprintf(line, sizeof(line), "%s\n    { \"offset\": %" PRIu64 ", \"length\": %" PRIu64 ", \"time\": %.6f }",
+                  (idx == 0) ? "" : ",", region.offset, region.length, region.time);
+    json += line;
+  }
+  json += profile.skipped_regions.empty() ? "],\n" : "\n  ],\n";
+
+  std::snprintf(line, sizeof(line), "  \"skipped_regions_dropped\": %" PRIu64 "\n}\n", profile.skipped_regions_dropped);
+  json += line;
+  return json;
+}
+
+
+
+int APBinDecoder::get_progress(void) const
+{
+  const uint64_t len = pass_len;
+  const int from = pass_from;
+  if ( len == 0 )
+  {
+    return from;
+  }
+  const uint64_t bytes = std::min<uint64_t>(pass_bytes, len);
+  return from + static_cast<int>(bytes * static_cast<uint64_t>(pass_to - from) / len);
+}
+
+
+
+void APBinDecoder::begin_pass_progress(const int& from, const int& to, const uint64_t& len)
+{
+  // the length is stored last, so a concurrent get_progress never scales the bytes of the previous pass into this range
+  pass_len = 0;
+  pass_bytes = 0;
+  pass_from = from;
+  pass_to = to;
+  pass_len = len;
+}
+
+
+
+bool APBinDecoder::decode_logfile(const uint8_t* buf, uint64_t len, APBinSource* source, APBinSink& sink, load_hooks& hooks,
+                                  load_report& report)
+{
+  // the decoder is reused for every logfile, start from a clean state
+  reset_definitions();
+  for (auto& instances : messages_store)
+  {
+    instances.reset();
+  }
+  retired_messages.clear();
+  for (auto& instances : series_store)
+  {
+    instances.reset();
+  }
+  live_decoding = false;
+  resumable = false;
+  selection_active = false;
+  multipliers_folded = false;
+  time_offset_folded = false;
+  has_gps_reference = false;
+  gps_reference_msg.clear();
+  time_index.clear();
+
+  // every pass parses the mapped logfile or reads the streamed logfile again
+  //  - the pass covers from - to percent of the progress, a streamed pass follows the position of its source
+  auto run_pass = [&](parse_context& ctx, const int& from, const int& to)
+  {
+    if ( cancel_requested )
+    {
+      return false;
+    }
+    ctx.bytes_parsed = &pass_bytes;
+    if ( source != nullptr )
+    {
+      begin_pass_progress(from, to, source->get_size());
+      return parse_stream(*source, ctx);
+    }
+    begin_pass_progress(from, to, ctx.end - ctx.begin);
+    return parse_messages(buf, len, ctx);
+  };
+
+  report = load_report();
+  report.bytes = len;
+  auto phase_start = std::chrono::steady_clock::now();
+
+  #ifdef DEBUG_RUNTIME
+    std::chrono::duration<double, std::milli> prescan_ms{ 0 };
+    std::chrono::duration<double, std::milli> process_units_ms{ 0 };
+    std::chrono::duration<double, std::milli> apply_tsync_ms{ 0 };
+    std::chrono::duration<double, std::milli> publish_ms{ 0 };
+  #endif
+
+
+  // -------------------- pre-scan -------------------- //
+  // walk through all headers without decoding any field and count the messages of each message id and instance,
+  // so that the columns can be reserved exactly before the decode pass
+  #ifdef DEBUG_RUNTIME
+    auto prescan_start = std::chrono::high_resolution_clock::now();
+  #endif
+  message_counts.assign(MAX_FORMATS * MAX_INSTANCES, 0);
+
+  // large mapped logfiles are split into chunks for parallel decoding
+  const int thread_count = (thread_count_limit > 0) ? thread_count_limit
+                                                    : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  decode_chunks.clear();
+  decode_chunk_size = (source == nullptr && thread_count > 1 && len >= PARALLEL_MIN_SIZE) ? (len / (thread_count * CHUNKS_PER_THREAD) + 1) : 0;
+  definitions_stable = true;
+  std::fill(std::begin(header_seen), std::end(header_seen), false);
+
+  parse_context prescan_ctx;
+  prescan_ctx.pass = parse_pass::COUNT;
+  prescan_ctx.end = (source != nullptr) ? UINT64_MAX : len;
+  if ( !run_pass(prescan_ctx, 0, PRESCAN_PROGRESS) )
+  {
+    return false;
+  }
+  if ( source != nullptr )
+  {
+    len = prescan_ctx.stream_bytes;
+    report.bytes = len;
+  }
+  if ( !decode_chunks.empty() )
+  {
+    decode_chunks.back().end = len;
+  }
+
+  // the final FMTU and MULT definitions are known, fold the multipliers and the time offset into the decode plans
+  fold_multipliers();
+  fold_time_offset();
+  update_time_range();
+
+  report.prescan_ms = take_elapsed_ms(phase_start);
+
+  // only the selected messages are decoded
+  if ( !select_messages(hooks) )
+  {
+    return false;
+  }
+  phase_start = std::chrono::steady_clock::now();
+
+  // -------------------- time window -------------------- //
+  // only the byte range around the selected time window is decoded
+  uint64_t decode_begin = 0;
+  uint64_t decode_end = len;
+  const bool windowed = get_window_range(len, decode_begin, decode_end);
+  if ( windowed && source == nullptr )
+  {
+    // count the messages of the byte range again, so that the columns and chunks only cover the time window
+    const uint64_t window_size = decode_end - decode_begin;
+    message_counts.assign(MAX_FORMATS * MAX_INSTANCES, 0);
+    decode_chunks.clear();
+    decode_chunk_size = (thread_count > 1 && window_size >= PARALLEL_MIN_SIZE) ? (window_size / (thread_count * CHUNKS_PER_THREAD) + 1) : 0;
+
+    parse_context window_ctx;
+    window_ctx.pass = parse_pass::COUNT;
+    window_ctx.final_definitions = true;
+    window_ctx.begin = decode_begin;
+    window_ctx.end = decode_end;
+    if ( !run_pass(window_ctx, PRESCAN_PROGRESS, PRESCAN_PROGRESS) )
+    {
+      return false;
+    }
+    if ( !decode_chunks.empty() )
+    {
+      decode_chunks.back().end = decode_end;
+    }
+  }
+  report.prescan_ms += take_elapsed_ms(phase_start);
+  #ifdef DEBUG_RUNTIME
+    auto prescan_end = std::chrono::high_resolution_clock::now();
+    prescan_ms += (prescan_end - prescan_start);
+  #endif
+
+
+  // the messages_store holds every decoded sample and is copied into the series by the publish step,
+  // so both exist at the same time (a point of a series holds the timestamp and the value)
+  //  -> publish the decoded samples directly, if both would take more than the given share of the physical memory
+  //  -> needs the final definitions and the time offset, because the samples can not be changed afterwards
+  //  -> the decimation needs all samples of a message instance, the decoded samples are always stored then
+  bool direct_publish = definitions_stable && (time_offset_folded || !has_gps_reference) && !load_selection.decimation.enabled;
+  #ifndef DIRECT_PUBLISH
+    const uint64_t store_peak_size = 3 * get_decoded_size();
+    const uint64_t physical_memory_size = get_physical_memory_size();
+    direct_publish = direct_publish && ( prefer_direct_publish || ( physical_memory_size > 0 &&
+                     store_peak_size > physical_memory_size / DIRECT_PUBLISH_MEMORY_SHARE ) );
+  #endif
+
+  // the messages of a streamed logfile are not counted again for a time window (it would be read once more),
+  // the counts of the whole logfile would reserve far too much, so the columns grow while decoding then
+  if ( windowed && source != nullptr )
+  {
+    message_counts.clear();
+  }
+
+
+  // -------------------- decode pass -------------------- //
+  parse_statistics stats;
+  if ( direct_publish )
+  {
+    // the series names contain the processed units
+    #ifdef DEBUG_RUNTIME
+      auto process_units_start = std::chrono::high_resolution_clock::now();
+    #endif
+    process_units();
+    #ifdef DEBUG_RUNTIME
+      auto process_units_end = std::chrono::high_resolution_clock::now();
+      process_units_ms += (process_units_end - process_units_start);
+    #endif
+
+    for (uint16_t msg_id = 0; msg_id < MAX_FORMATS; msg_id++)
+    {
+      apply_folding(msg_id);
+    }
+
+    parse_context publish_ctx;
+    publish_ctx.pass = parse_pass::PUBLISH;
+    publish_ctx.final_definitions = true;
+    publish_ctx.begin = decode_begin;
+    publish_ctx.end = decode_end;
+    publish_ctx.sink = &sink;
+    const bool published = run_pass(publish_ctx, PRESCAN_PROGRESS, 100);
+    for (auto& instances : series_store)
+    {
+      instances.reset();
+    }
+    if ( !published )
+    {
+      return false;
+    }
+    stats = publish_ctx.stats;
+
+    if ( !time_offset_folded )
+    {
+      std::printf("Skipping timesync because the logfile does not contain enough GNSS data\n");
+    }
+  }
+  else if ( definitions_stable && decode_chunks.size() > 1 )
+  {
+    // the final definitions of the pre-scan are valid for every message, decode all chunks in parallel
+    for (uint16_t msg_id = 0; msg_id < MAX_FORMATS; msg_id++)
+    {
+      apply_folding(msg_id);
+    }
+    report.parallel = true;
+    if ( !decode_parallel(buf, len, thread_count, stats) )
+    {
+      return false;
+    }
+  }
+  else
+  {
+    // the decode pass rebuilds all definitions in file order, exactly as a single pass would see them
+    reset_definitions();
+
+    parse_context decode_ctx;
+    decode_ctx.pass = parse_pass::DECODE;
+    decode_ctx.data_begin = decode_begin;
+    decode_ctx.end = decode_end;
+    if ( !run_pass(decode_ctx, PRESCAN_PROGRESS, 100) )
+    {
+      return false;
+    }
+    stats = decode_ctx.stats;
+  }
+  decode_chunks.clear();
+  message_counts.clear();
+  message_counts.shrink_to_fit();
+  report.direct_publish = direct_publish;
+  report.decode_ms = take_elapsed_ms(phase_start);
+
+  // the decoded columns are complete, they are largest before publishing
+  build_profile(stats, report.profile);
+
+
+  // -------------------- process UNITs -------------------- //
+  #ifdef DEBUG_RUNTIME
+      auto process_units_start = std::chrono::high_resolution_clock::now();
+  #endif
+  // direct publishing has already processed the units
+  if ( !direct_publish )
+  {
+    process_units();
+  }
+  #ifdef DEBUG_RUNTIME
+    auto process_units_end = std::chrono::high_resolution_clock::now();
+    process_units_ms += (process_units_end - process_units_start);
+  #endif
+
+
+  // -------------------- apply timesync -------------------- //
+  #ifdef DEBUG_RUNTIME
+    auto apply_tsync_start = std::chrono::high_resolution_clock::now();
+  #endif
+  // only needed, if the time offset was not folded into the decode plans (and the samples are not published yet)
+  if ( !time_offset_folded && !direct_publish )
+  {
+    apply_timesync();
+  }
+  #ifdef DEBUG_RUNTIME
+    auto apply_tsync_end = std::chrono::high_resolution_clock::now();
+    apply_tsync_ms += (apply_tsync_end - apply_tsync_start);
+  #endif
+
+
+
+  #ifdef DEBUG_MESSAGES
+  std::printf("\n--------- DEBUG_MESSAGES ---------");
+  for (int idx=0; idx < 256; idx++)
+  {
+    if (has_fmt[idx])
+    {
+      const struct log_Format& fmt = formats[idx];
+      std::string msg_name = std::string(fmt.name, MAX_NAME_SIZE);
+      std::string msg_labels = std::string(fmt.labels, MAX_LABELS_SIZE);
+      std::string msg_format = std::string(fmt.format, MAX_FORMAT_SIZE);
+      std::printf("\n%s:\n", msg_name.c_str());
+      std::printf("  -id: \t\t%u\n", fmt.type);
+      std::printf("  -labels: \t%s\n", msg_labels.c_str());
+      std::printf("  -format: \t%s\n", msg_format.c_str());
+      if (has_fmtu[idx])
+      {
+        const struct log_Format_Units& fmtu = format_units[idx];
+        std::string msg_units = std::string(fmtu.units, MAX_UNITS_SIZE);
+        std::string msg_multipliers = std::string(fmtu.multipliers, MAX_MULTIPLIERS_SIZE);
+        std::printf("  -units: \t%s\n", msg_units.c_str());
+        std::printf("  -multipliers: %s\n", msg_multipliers.c_str());
+        if (has_instance[idx] == true)
+        {
+          std::printf("  -has instance at idx: %i\n", instance_idx[idx]);
+        }        
+      }
+    }
+  }
+  std::printf("-------------- END --------------\n\n");
+  #endif
+
+  #ifdef DEBUG_MULTIPLIERS
+  std::printf("\n------- DEBUG_MULTIPLIERS -------\n");
+  for(const auto& multi_it : multipliers)
+  {
+    std::cout << multi_it.first << ": " << multi_it.second << std::endl;
+  }
+  std::printf("-------------- END --------------\n\n");
+  #endif
+
+  #ifdef DEBUG_UNITS
+  std::printf("\n---------- DEBUG_UNITS ----------\n");
+  for(const auto& unit_it : units)
+  {
+    std::cout << unit_it.first << ": " << unit_it.second << std::endl;
+  }
+  std::printf("-------------- END --------------\n\n");
+  #endif
+
+
+
+  report.postprocess_ms = take_elapsed_ms(phase_start);
+
+
+  // -------------------- publish to the sink -------------------- //
+  #ifdef DEBUG_RUNTIME
+    auto publish_start = std::chrono::high_resolution_clock::now();
+  #endif
+  // the messages_store is empty, if the samples were published directly
+  publish_messages(sink);
+  #ifdef DEBUG_RUNTIME
+    auto publish_end = std::chrono::high_resolution_clock::now();
+    publish_ms += (publish_end - publish_start);
+  #endif
+
+  report.publish_ms = take_elapsed_ms(phase_start);
+  report.bytes_skipped = stats.bytes_skipped;
+  report.msgs_skipped = stats.msgs_skipped;
+  report.msgs_outside_window = stats.msgs_outside_window;
+  report.msgs_read = stats.msgs_read;
+
+  // the messages_store and the definitions are kept, a grown logfile only needs its appended bytes decoded (see resume)
+  //  - the pre-scan stopped in front of the first message, which is not complete yet
+  if ( source == nullptr && !windowed && !direct_publish )
+  {
+    record_resume_point(buf, prescan_ctx.parsed);
+  }
+
+  #ifdef DEBUG_RUNTIME
+    std::chrono::duration<double, std::milli> total_ms = prescan_ms + stats.fmt_ms + stats.fmtu_ms + stats.mult_ms + stats.unit_ms + stats.other_ms + process_units_ms + apply_tsync_ms + publish_ms;
+    std::printf("\n--------- DEBUG_RUNTIME ---------");
+    std::printf("\nPre-Scan (ms): \t\t%.2f", prescan_ms.count());
+    std::printf("\nFMT-Loading (ms): \t%.2f", stats.fmt_ms.count());
+    std::printf("\nFMTU-Loading (ms): \t%.2f", stats.fmtu_ms.count());
+    std::printf("\nMULT-Loading (ms): \t%.2f", stats.mult_ms.count());
+    std::printf("\nUNIT-Loading (ms): \t%.2f", stats.unit_ms.count());
+    std::printf("\nOTHER-Loading (ms): \t%.2f\n", stats.other_ms.count());
+
+    std::printf("\nProcess-Units (ms):\t%.2f", process_units_ms.count());
+    std::printf("\nApply-Timesync (ms):\t%.2f", apply_tsync_ms.count());
+    std::printf("\nPublish (ms):\t\t%.2f", publish_ms.count());
+    std::printf("\n---------------------------------");
+    std::printf("\nTOTAL (ms):\t\t%.2f", total_ms.count());
+    std::printf("\n-------------- END --------------\n\n");
+  #endif
+
+  return true;
+}
+
+
+
+void APBinDecoder::publish_messages(APBinSink& sink)
+{
+  std::vector<const std::string*> series_names;
+
+  // the samples of redefined messages precede the samples of their current layout
+  for (const auto& retired : retired_messages)
+  {
+    for (uint16_t instance = 0; instance < MAX_INSTANCES; instance++)
+    {
+      if ( !(*retired.instances)[instance] )
+      {
+        continue;
+      }
+      series_names.clear();
+      for (const std::string& name : retired.series_names[instance])
+      {
+        series_names.push_back(name.empty() ? nullptr : &name);
+      }
+      publish_instance(*(*retired.instances)[instance], retired.time_column, retired.msg_name, series_names, sink);
+    }
+  }
+
+  // iterate through messages
+  for (uint16_t msg_id = 0; msg_id < MAX_FORMATS; msg_id++)
+  {
+    if ( !messages_store[msg_id] )
+    {
+      continue;
+    }
+
+    // resolve message name for message id
+    const std::string& msg_name = msg_id2name[msg_id];
+
+    // only publish messages, which have a decoded "TimeUS" field!
+    if ( decode_plans[msg_id].time_column < 0 )
+    {
+      std::printf("Ignoring message '%s' because it has no 'TimeUS' field!\n", msg_name.c_str());
+      continue;
+    }
+    const size_t time_idx = decode_plans[msg_id].time_column;
+    
+    // iterate through instances
+    const message_instances& instances = *messages_store[msg_id];
+    for (uint16_t instance = 0; instance < MAX_INSTANCES; instance++)
+    {
+      if ( !instances[instance] )
+      {
+        continue;
+      }
+      const message_data& msg_data = *instances[instance];
+
+      // the timestamp, the instance and the undecoded fields are not published
+      series_names.assign(msg_data.size(), nullptr);
+      for (size_t idx = 0; idx < msg_data.size(); idx++)
+      {
+        if ( idx == time_idx || ( has_instance[msg_id] && (static_cast<int>(idx) == instance_idx[msg_id]) ) ||
+             ( decode_plans[msg_id].skip_mask & (1u << idx) ) )
+        {
+          continue;
+        }
+        series_names[idx] = &get_series_name(msg_id, instance, idx);
+      }
+      publish_instance(msg_data, time_idx, msg_name, series_names, sink);
+    }
+  }
+}
+
+
+
+void APBinDecoder::reset_definitions(void)
+{
+  multipliers.clear();
+  units.clear();
+
+  std::fill(std::begin(formats), std::end(formats), log_Format{});
+  std::fill(std::begin(format_units), std::end(format_units), log_Format_Units{});
+  std::fill(std::begin(has_fmt), std::end(has_fmt), false);
+  std::fill(std::begin(has_fmtu), std::end(has_fmtu), false);
+
+  std::fill(std::begin(decode_plans), std::end(decode_plans), decode_plan());
+  std::fill(std::begin(handlers), std::end(handlers), msg_handler::NONE);
+
+  std::fill(std::begin(has_instance), std::end(has_instance), false);
+  std::fill(std::begin(instance_idx), std::end(instance_idx), -1);
+  std::fill(std::begin(instance_offset), std::end(instance_offset), 0);
+
+  std::fill(std::begin(msg_id2name), std::end(msg_id2name), std::string());
+  msg_name2id.clear();
+  field_name2idx.clear();
+  gps_msg_id = -1;
+
+  for (auto& names : series_names_store)
+  {
+    names.reset();
+  }
+}
+
+
+
+bool APBinDecoder::parse_messages(const uint8_t* buf, const uint64_t& len, parse_context& ctx)
+{
+  parse_statistics& stats = ctx.stats;
+
+  uint64_t total_bytes_used = ctx.begin;
+  uint64_t bytes_released = ctx.begin;
+  uint64_t bytes_reported = ctx.begin;
+  uint64_t next_chunk_begin = ctx.begin;
+
+  // pre-scan: checkpoints of the time index, the last message with a timestamp closes the index
+  const bool build_time_index = ( ctx.pass == parse_pass::COUNT && !ctx.final_definitions );
+  int last_timed_id = -1;
+  uint64_t last_timed_offset = 0;
+
+  // chunk workers: next row of each message id and instance in the pre-allocated columns
+  std::vector<uint32_t> rows;
+  if ( ctx.pass == parse_pass::DECODE_CHUNK )
+  {
+    rows.assign(MAX_FORMATS * MAX_INSTANCES, 0);
+    for (const auto& first_row : ctx.first_rows)
+    {
+      rows[first_row.first] = first_row.second;
+    }
+  }
+
+  while (true)
+  {
+    // give already parsed pages of the mapping back to the kernel
+    if (ctx.mapped && total_bytes_used - bytes_released >= MAPPED_RELEASE_STEP)
+    {
+      release_mapped_region(buf, bytes_released, total_bytes_used);
+      bytes_released = total_bytes_used;
+    }
+
+    // report the progress to the byte counter and check for a cancel (polled by other threads, see get_progress)
+    if (total_bytes_used - bytes_reported >= PROGRESS_STEP)
+    {
+      *ctx.bytes_parsed += total_bytes_used - bytes_reported;
+      bytes_reported = total_bytes_used;
+      if (cancel_requested)
+      {
+        return false;
+      }
+    }
+
+    // pre-scan: split the logfile into chunks for parallel decoding
+    //  - a chunk starts at a position which the walk through the logfile reaches anyway, so workers
+    //    starting there are in sync with the message headers and parse exactly the same messages
+    if ( ctx.pass == parse_pass::COUNT && decode_chunk_size > 0 && total_bytes_used >= next_chunk_begin )
+    {
+      add_decode_chunk(total_bytes_used);
+      next_chunk_begin = total_bytes_used + decode_chunk_size;
+    }
+
+    // check if end of chunk is reached
+    if (total_bytes_used >= ctx.end)
+    {
+      break;
+    }
+
+    // check if end of file is reached (or the end of the buffer, which is continued by the next one)
+    if (len - total_bytes_used < LOG_PACKET_HEADER_LEN)
+    {
+      stats.skip(ctx.base + total_bytes_used, ctx.more_input ? 0 : len - total_bytes_used);
+      break;
+    }
+
+    // detect message start sequence (header)
+    // skip through input until we find a valid header:
+    //  - the search stops before the last two bytes, where the end of file is detected
+    if (buf[total_bytes_used] != HEAD_BYTE1 || buf[total_bytes_used + 1] != HEAD_BYTE2)
+    {
+      const uint64_t next_header = find_next_header(buf, total_bytes_used + 1, len - (LOG_PACKET_HEADER_LEN - 1));
+      stats.skip(ctx.base + total_bytes_used, next_header - total_bytes_used);
+      total_bytes_used = next_header;
+      continue;
+    }
+
+    // get message-id from header
+    const uint8_t type = buf[total_bytes_used + 2];
+
+
+    // -------------------- handle FMT-message -------------------- //
+    if (type == LOG_FORMAT_MSG)
+    {
+      #ifdef DEBUG_RUNTIME
+        auto fmt_start = std::chrono::high_resolution_clock::now();
+      #endif
+
+      // check if we don't reach the end
+      if (len - total_bytes_used < sizeof(struct log_Format))
+      {
+        stats.skip(ctx.base + total_bytes_used, ctx.more_input ? 0 : len - total_bytes_used);
+        break;
+      }
+
+      // extract the message-id for which the FMT-message is defined and store FMT
+      const uint8_t msg_id = ((struct log_Format*)(&(buf[total_bytes_used])))->type;
+      stats.messages[LOG_FORMAT_MSG].bytes += sizeof(struct log_Format);
+      stats.messages[LOG_FORMAT_MSG].messages++;
+
+      // definitions are complete after the pre-scan, only step over the FMT-message
+      if ( ctx.final_definitions )
+      {
+        for (char i : ((struct log_Format*)(&(buf[total_bytes_used])))->name)
+        {
+          if (!isprint(i) && i != '\0')
+          {
+            stats.skip(ctx.base + total_bytes_used, 1);
+            total_bytes_used++;
+          }
+        }
+        total_bytes_used += sizeof(struct log_Format);
+        stats.msgs_read++;
+        continue;
+      }
+
+      // pre-scan: messages of this id were already parsed with the previous definition,
+      // decoding them with the final definition would give a different result
+      if ( ctx.pass == parse_pass::COUNT && header_seen[msg_id] &&
+           memcmp(&formats[msg_id], &buf[total_bytes_used], sizeof(struct log_Format)) != 0 )
+      {
+        definitions_stable = false;
+      }
+
+      // the decoded data of a message id is stored by id, a redefinition with another layout would corrupt it
+      //  - the samples of the previous layout are kept aside and published in front of the new ones
+      //  - live decoding creates the series of the message again with the new layout
+      if ( (messages_store[msg_id] || series_store[msg_id]) &&
+           memcmp(&formats[msg_id], &buf[total_bytes_used], sizeof(struct log_Format)) != 0 )
+      {
+        std::fprintf(stderr, "WARNING: FMT of message %s redefined! Keeping previously decoded data in its layout!\n", msg_id2name[msg_id].c_str());
+        retire_message(msg_id);
+        series_store[msg_id].reset();
+        if ( live_decoding )
+        {
+          std::fill(std::begin(field_scales[msg_id]), std::end(field_scales[msg_id]), 1.0);
+        }
+      }
+
+      has_fmt[msg_id] = true;
+      struct log_Format& fmt = formats[msg_id];
+      memcpy(&fmt, &buf[total_bytes_used], sizeof(struct log_Format));
+      for (char i : fmt.name)
+      {
+        if (!isprint(i) && i != '\0')
+        {
+          // double check that this is a message
+          // name is assumed to be printable ascii; it
+          // looked like a format message, but wasn't.
+          stats.skip(ctx.base + total_bytes_used, 1);
+          total_bytes_used++;
+          continue;
+        }
+      }
+
+      // store message name <-> message id mapping
+      uint8_t name_length = 0;
+      for (char i : fmt.name)
+      {
+        if (i != '\0')
+        {
+          name_length++;
+        }
+      }
+      std::string msg_name(fmt.name, name_length);
+      msg_id2name[msg_id] = msg_name; 
+      msg_name2id[msg_name] = msg_id;
+      if ( msg_name == "GPS" )
+      {
+        gps_msg_id = msg_id;
+      }
+
+      // store field name (label) <-> field idx mapping
+      uint8_t label_length = 0;
+      for (char i : fmt.labels)
+      {
+        if (i != '\0')
+        {
+          label_length++;
+        }
+      }
+      std::string labels(fmt.labels, label_length);
+      std::vector<std::string> labels_vec{};
+
+      // split labels at delimiter ","
+      size_t pos = 0;
+      std::string label;
+      while ( (pos = labels.find(",")) != std::string::npos )
+      {
+        label = labels.substr(0,pos);
+        labels_vec.push_back(label);
+        labels.erase(0, pos + 1);
+      }
+      labels_vec.push_back(labels);
+
+      // go through labels
+      for (size_t idx = 0; idx < labels_vec.size(); idx++)
+      {
+        const std::string& label = labels_vec[idx];
+        field_name2idx[msg_name][label] = idx;
+
+        /*
+        This is not needed, since the detection based on the unit char '#' is sufficient
+        // handle instances
+        //  - check if labels contain "instance"
+        if (strcmp(label.c_str(), "Instance") == 0)
+        {
+          has_instance[msg_id] = true;
+          instance_idx[msg_id] = idx;
+          instance_offset[msg_id] = get_field_byte_offset(msg_id, idx);
+        }
+        */
+      }
+
+      // compile the decode plan, so that the field layout is not evaluated again for every message
+      compile_decode_plan(msg_id, (label_length == 0) ? 0 : labels_vec.size());
+      handlers[msg_id] = select_message_handler(msg_id, msg_name);
+      series_names_store[msg_id].reset();
+
+      total_bytes_used += sizeof(struct log_Format);
+      stats.msgs_read++;
+
+      #ifdef DEBUG_RUNTIME
+        auto fmt_end = std::chrono::high_resolution_clock::now();
+        stats.fmt_ms += (fmt_end - fmt_start);
+      #endif
+
+      continue;
+    }
+
+    // get the full log format from the message type
+    const struct log_Format& fmt = formats[type];
+    if ( ctx.pass == parse_pass::COUNT )
+    {
+      // only the pre-scan checks the definitions (chunk workers would share this flag)
+      header_seen[type] = true;
+    }
+
+    // checks:
+    //  - if length of message is zero, continue
+    if ( fmt.length == 0 )
+    {
+      stats.skip(ctx.base + total_bytes_used, 1);
+      total_bytes_used += 1;
+      continue;
+    }
+    //  - if we reached the end of the log, just end
+    if (len - total_bytes_used < fmt.length)
+    {
+      stats.skip(ctx.base + total_bytes_used, ctx.more_input ? 0 : len - total_bytes_used);
+      break;
+    }
+
+    // load profile: every complete message is counted for its type
+    message_counters& counters = stats.messages[type];
+    counters.bytes += fmt.length;
+    counters.messages++;
+
+    // definitions are complete after the pre-scan, only step over definition messages
+    if ( ctx.final_definitions &&
+         (handlers[type] == msg_handler::FMTU || handlers[type] == msg_handler::MULT || handlers[type] == msg_handler::UNIT) )
+    {
+      total_bytes_used += fmt.length;
+      stats.msgs_read++;
+      continue;
+    }
+
+
+    // -------------------- dispatch message -------------------- //
+    // the handler of each message id is selected once when its FMT is parsed (see select_message_handler)
+    switch (handlers[type])
+    {
+      // -------------------- handle FMTU-message -------------------- //
+      case msg_handler::FMTU:
+      {
+        #ifdef DEBUG_RUNTIME
+          auto fmtu_start = std::chrono::high_resolution_clock::now();
+        #endif
+
+        // extract the message-id for which the FMTU-message is defined and store FMTU
+        const uint8_t msg_id = ((struct log_Format_Units*)(&(buf[total_bytes_used])))->format_type;
+        has_fmtu[msg_id] = true;
+        struct log_Format_Units& fmtu = format_units[msg_id];
+        memcpy(&fmtu, &buf[total_bytes_used], sizeof(struct log_Format_Units));
+        series_names_store[msg_id].reset();
+
+
+        // handle instances
+        //  - check if units contain "#" (see also: logformat.h)
+        if ( !has_instance[msg_id] )
+        {
+          uint8_t units_length = 0;
+          for (char i : fmtu.units)
+          {
+            if (i != '\0')
+            {
+              units_length++;
+            }
+          }
+          std::string units(fmtu.units, units_length);
+
+          size_t pos = units.find("#");
+          if ( pos != std::string::npos )
+          {
+            // pre-scan: messages of this id were already parsed without instance
+            if ( ctx.pass == parse_pass::COUNT && header_seen[msg_id] )
+            {
+              definitions_stable = false;
+            }
+
+            has_instance[msg_id] = true;
+            instance_idx[msg_id] = pos;
+            instance_offset[msg_id] = get_field_byte_offset(msg_id, pos);
+          }
+        } 
+        
+        total_bytes_used += fmt.length;
+        stats.msgs_read++;
+
+        #ifdef DEBUG_RUNTIME
+          auto fmtu_end = std::chrono::high_resolution_clock::now();
+          stats.fmtu_ms += (fmtu_end - fmtu_start);
+        #endif
+
+        continue;
+      }
+
+
+      // -------------------- handle MULT-message -------------------- //
+      case msg_handler::MULT:
+      {
+        #ifdef DEBUG_RUNTIME
+          auto mult_start = std::chrono::high_resolution_clock::now();
+        #endif
+
+        uint32_t id_offset = get_field_byte_offset(type, "Id");
+        uint32_t mult_offset = get_field_byte_offset(type, "Mult");
+
+        // todo: data type is hardcoded here, change that?!
+        const unsigned char multiplier_char = *reinterpret_cast<const uint8_t*>(buf + total_bytes_used + id_offset);
+        const double multiplier = *reinterpret_cast<const double*>(buf + total_bytes_used + mult_offset);
+
+        multipliers[multiplier_char] = multiplier;
+      
+        total_bytes_used += fmt.length;
+        stats.msgs_read++;
+
+        #ifdef DEBUG_RUNTIME
+          auto mult_end = std::chrono::high_resolution_clock::now();
+          stats.mult_ms += (mult_end - mult_start);
+        #endif
+
+        continue;
+      }
+
+
+      // -------------------- handle UNIT-message -------------------- //
+      case msg_handler::UNIT:
+      {
+        #ifdef DEBUG_RUNTIME
+          auto unit_start = std::chrono::high_resolution_clock::now();
+        #endif
+
+        uint32_t id_offset = get_field_byte_offset(type, "Id");
+        uint32_t label_offset = get_field_byte_offset(type, "Label");
+
+        // todo: data type is hardcoded here, change that?!
+        const unsigned char unit_char = *reinterpret_cast<const uint8_t*>(buf + total_bytes_used + id_offset);
+        const char* unit = reinterpret_cast<const char*>(buf + total_bytes_used + label_offset);
+
+        units[unit_char] = std::string(unit);
+
+        // the units are part of the series names of all messages
+        #ifdef LABEL_WITH_UNIT
+          for (auto& names : series_names_store)
+          {
+            names.reset();
+          }
+        #endif
+
+        total_bytes_used += fmt.length;
+        stats.msgs_read++;
+
+        #ifdef DEBUG_RUNTIME
+          auto unit_end = std::chrono::high_resolution_clock::now();
+          stats.unit_ms += (unit_end - unit_start);
+        #endif
+
+        continue;
+      }
+
+
+      // -------------------- discard message -------------------- //
+      // messages that should not be used (see skipped_messages) or can not be decoded (see compile_decode_plan)
+      case msg_handler::SKIP:
+      {
+        total_bytes_used += fmt.length;
+        stats.msgs_skipped++;
+        counters.skipped++;
+        continue;
+      }
+
+
+      // -------------------- handle any other message -------------------- //
+      case msg_handler::DATA:
+      {
+        // pre-scan: only count the message, its fields are decoded in the decode pass
+        if ( ctx.pass == parse_pass::COUNT )
+        {
+          const uint8_t instance = has_instance[type] ? get_instance(fmt, &buf[total_bytes_used]) : 0;
+          const uint32_t count = ++message_counts[type * MAX_INSTANCES + instance];
+
+          // the second message of the first GPS instance is the timesync reference (see apply_timesync)
+          if ( type == gps_msg_id && instance == 0 && count == 2 && !ctx.final_definitions )
+          {
+            has_gps_reference = true;
+            gps_reference_msg.assign(&buf[total_bytes_used], &buf[total_bytes_used] + fmt.length);
+          }
+
+          // record a checkpoint of the time index in steps of TIME_INDEX_STEP
+          if ( build_time_index && decode_plans[type].time_column >= 0 )
+          {
+            if ( ctx.base + total_bytes_used >= ctx.next_checkpoint )
+            {
+              time_index.push_back(get_time_checkpoint(&buf[total_bytes_used], ctx.base + total_bytes_used, type));
+              ctx.next_checkpoint = ctx.base + total_bytes_used + TIME_INDEX_STEP;
+            }
+            last_timed_id = type;
+            last_timed_offset = total_bytes_used;
+          }
+
+          total_bytes_used += fmt.length;
+          continue;
+        }
+
+        // time window: messages in front of the window are not decoded (they are counted apart from the skipped ones)
+        if ( ctx.base + total_bytes_used < ctx.data_begin )
+        {
+          total_bytes_used += fmt.length;
+          stats.msgs_outside_window++;
+          counters.outside_window++;
+          continue;
+        }
+
+        // load profile: every PROFILE_SAMPLE_INTERVAL-th decoded message of a type is timed
+        const bool timed = ( (counters.decoded++ & (PROFILE_SAMPLE_INTERVAL - 1)) == 0 );
+        std::chrono::steady_clock::time_point decode_start;
+        if ( timed )
+        {
+          decode_start = std::chrono::steady_clock::now();
+        }
+
+        #ifdef DEBUG_RUNTIME
+          auto other_start = std::chrono::high_resolution_clock::now();
+        #endif
+
+        if ( ctx.pass == parse_pass::DECODE_CHUNK )
+        {
+          handle_message_received(fmt, &buf[total_bytes_used], rows);
+        }
+        else if ( ctx.pass == parse_pass::PUBLISH || ctx.pass == parse_pass::LIVE )
+        {
+          handle_message_received(fmt, &buf[total_bytes_used], *ctx.sink);
+        }
+        else
+        {
+          handle_message_received(fmt, &buf[total_bytes_used]);
+        }
+
+        if ( timed )
+        {
+          counters.sampled_time += std::chrono::steady_clock::now() - decode_start;
+          counters.sampled++;
+        }
+
+        total_bytes_used += fmt.length;
+        stats.msgs_read++; // todo: this is incorrect, if message is read incomplete
+
+        #ifdef DEBUG_RUNTIME
+          auto other_end = std::chrono::high_resolution_clock::now();
+          stats.other_ms += (other_end - other_start);
+        #endif
+
+        continue;
+      }
+
+
+      // -------------------- handle message without FMT -------------------- //
+      case msg_handler::NONE:
+      default:
+      {
+        stats.skip(ctx.base + total_bytes_used, 1);
+        total_bytes_used += 1;
+        continue;
+      }
+    }
+  }
+
+  // the last message with a timestamp closes the time index (a streamed logfile continues in the next buffer)
+  if ( build_time_index && last_timed_id >= 0 )
+  {
+    ctx.last_checkpoint = get_time_checkpoint(&buf[last_timed_offset], ctx.base + last_timed_offset, last_timed_id);
+    ctx.has_last_checkpoint = true;
+  }
+  if ( build_time_index && !ctx.more_input && ctx.has_last_checkpoint &&
+       (time_index.empty() || time_index.back().offset != ctx.last_checkpoint.offset) )
+  {
+    time_index.push_back(ctx.last_checkpoint);
+  }
+  ctx.parsed = total_bytes_used;
+  *ctx.bytes_parsed += total_bytes_used - bytes_reported;
+
+  return true;
+}
+
+
+
+bool APBinDecoder::parse_stream(APBinSource& source, parse_context& ctx)
+{
+  // the progress follows the position of the source, not the parsed bytes of the buffers
+  std::atomic<uint64_t>* progress_bytes = ctx.bytes_parsed;
+  std::atomic<uint64_t> bytes_parsed{ 0 };
+  ctx.bytes_parsed = &bytes_parsed;
+  ctx.mapped = false;
+
+  const uint64_t begin = ctx.begin;
+  const uint64_t end = ctx.end;
+  bool parsed_to_end = false;
+  std::string error;
+
+  if ( !source.rewind() )
+  {
+    error = source.get_error();
+  }
+  else
+  {
+    StreamProducer producer(source, STREAM_BUFFER_SIZE, STREAM_BUFFER_COUNT, STREAM_CARRY);
+    StreamProducer::buffer* current = nullptr;
+    uint64_t base = 0;      // byte-offset of the first byte of data in the logfile
+    uint64_t carry = 0;     // bytes of an incomplete message at the end of the previous buffer
+
+    while ( !parsed_to_end )
+    {
+      // the incomplete message of the previous buffer is copied in front of the next one
+      StreamProducer::buffer* next = producer.next();
+      uint8_t* data = next->memory.data() + STREAM_CARRY - carry;
+      if ( carry > 0 )
+      {
+        memcpy(data, current->memory.data() + STREAM_CARRY + current->size - carry, carry);
+      }
+      if ( current != nullptr )
+      {
+        producer.release(current);
+      }
+      current = next;
+      const uint64_t len = carry + current->size;
+      parsed_to_end = current->last;
+      error = current->error;
+
+      // the buffers in front of the range are only read
+      if ( base + len > begin )
+      {
+        ctx.base = base;
+        ctx.begin = (begin > base) ? begin - base : 0;
+        ctx.end = std::min(len, end - base);
+        ctx.more_input = !current->last;
+        if ( !parse_messages(data, len, ctx) )
+        {
+          ctx.bytes_parsed = progress_bytes;
+          return false;
+        }
+        parsed_to_end = parsed_to_end || (base + ctx.parsed >= end);
+      }
+      else
+      {
+        ctx.parsed = len;
+      }
+
+      // a message is never longer than the carry room (a corrupted FMT may step a few bytes over the end)
+      const uint64_t parsed = std::min(ctx.parsed, len);
+      carry = len - parsed;
+      base += parsed;
+
+      // report the progress and check for a cancel (the buffers in front of the range are not parsed)
+      *progress_bytes = current->position;
+      if ( cancel_requested )
+      {
+        ctx.bytes_parsed = progress_bytes;
+        return false;
+      }
+    }
+    ctx.stream_bytes = base + carry;
+  }
+
+  if ( !error.empty() )
+  {
+    std::fprintf(stderr, "WARNING: reading the logfile failed: %s! Loading the logfile up to there!\n", error.c_str());
+  }
+
+  ctx.bytes_parsed = progress_bytes;
+  *progress_bytes = source.get_size();
+  return true;
+}
+
+
+
+bool APBinDecoder::select_messages(load_hooks& hooks)
+{
+  // list all messages, which would be decoded, with their metadata from the pre-scan
+  logfile_messages.clear();
+  for (uint16_t msg_id = 0; msg_id < MAX_FORMATS; msg_id++)
+  {
+    if ( handlers[msg_id] != msg_handler::DATA )
+    {
+      continue;
+    }
+    message_info message{ msg_id2name[msg_id], 0, 0 };
+    for (uint16_t instance = 0; instance < MAX_INSTANCES; instance++)
+    {
+      const uint32_t count = message_counts[msg_id * MAX_INSTANCES + instance];
+      if ( count > 0 )
+      {
+        message.instances++;
+        message.samples += count;
+      }
+    }
+    if ( message.samples > 0 )
+    {
+      logfile_messages.push_back(message);
+    }
+  }
+
+  if ( !hooks.select_messages(logfile_messages, logfile_time_range, load_selection) )
+  {
+    return false;
+  }
+
+  // unselected messages are discarded without decoding and are not allocated
+  selection_active = true;
+  for (uint16_t msg_id = 0; msg_id < MAX_FORMATS; msg_id++)
+  {
+    if ( handlers[msg_id] == msg_handler::DATA &&
+         !matches(load_selection.messages, msg_id2name[msg_id]) )
+    {
+      handlers[msg_id] = msg_handler::SKIP;
+      std::fill_n(message_counts.begin() + msg_id * MAX_INSTANCES, MAX_INSTANCES, 0);
+    }
+  }
+
+  return true;
+}
+
+
+
+APBinDecoder::time_checkpoint APBinDecoder::get_time_checkpoint(const uint8_t* msg, const uint64_t& offset, const uint8_t& msg_id)
+{
+  time_checkpoint checkpoint{ offset, 0 };
+
+  const decode_plan& plan = decode_plans[msg_id];
+  for (const auto& field : plan.fields)
+  {
+    if ( field.column == plan.time_column )
+    {
+      checkpoint.time = field.convert(msg + field.offset) * 1e-6;
+      break;
+    }
+  }
+  return checkpoint;
+}
+
+
+
+void APBinDecoder::update_time_range(void)
+{
+  logfile_time_range = time_range();
+  for (size_t idx = 0; idx < time_index.size(); idx++)
+  {
+    const double& time = time_index[idx].time;
+    logfile_time_range.first = (idx == 0) ? time : std::min(logfile_time_range.first, time);
+    logfile_time_range.last = (idx == 0) ? time : std::max(logfile_time_range.last, time);
+  }
+  logfile_time_range.has_utc = time_offset_folded;
+  logfile_time_range.utc_offset = time_offset_folded ? folded_time_offset : 0;
+}
+
+
+
+double APBinDecoder::get_offset_time(const uint64_t& offset) const
+{
+  // the checkpoints are ordered by their byte-offset
+  auto checkpoint = std::upper_bound(time_index.begin(), time_index.end(), offset,
+                                     [](const uint64_t& value, const time_checkpoint& cp) { return value < cp.offset; });
+  if ( checkpoint != time_index.begin() )
+  {
+    checkpoint--;
+  }
+  if ( checkpoint == time_index.end() )
+  {
+    return 0;
+  }
+  return checkpoint->time + (time_offset_folded ? folded_time_offset : 0);
+}
+
+
+
+void APBinDecoder::build_profile(const parse_statistics& stats, load_profile& profile) const
+{
+  profile = load_profile();
+  for (uint16_t msg_id = 0; msg_id < MAX_FORMATS; msg_id++)
+  {
+    const message_counters& counters = stats.messages[msg_id];
+    if ( counters.messages == 0 )
+    {
+      continue;
+    }
+
+    message_profile message;
+    message.name = !msg_id2name[msg_id].empty() ? msg_id2name[msg_id] : (msg_id == LOG_FORMAT_MSG) ? "FMT" : std::to_string(msg_id);
+    message.msg_id = static_cast<uint8_t>(msg_id);
+    message.bytes = counters.bytes;
+    message.messages = counters.messages;
+    message.skipped = counters.skipped;
+    message.outside_window = counters.outside_window;
+    if ( counters.sampled > 0 )
+    {
+      const double sampled_ms = std::chrono::duration<double, std::milli>(counters.sampled_time).count();
+      message.decode_ms = sampled_ms * static_cast<double>(counters.decoded) / static_cast<double>(counters.sampled);
+    }
+    profile.messages.push_back(message);
+  }
+
+  profile.skipped_regions = stats.skipped_regions;
+  for (auto& region : profile.skipped_regions)
+  {
+    region.time = get_offset_time(region.offset);
+  }
+  profile.skipped_regions_dropped = stats.skipped_regions_dropped;
+  profile.start_time = get_offset_time(0);
+
+  for (const auto& instances : messages_store)
+  {
+    if ( !instances )
+    {
+      continue;
+    }
+    for (const auto& msg_data : *instances)
+    {
+      if ( !msg_data )
+      {
+        continue;
+      }
+      for (const auto& column : *msg_data)
+      {
+        profile.column_bytes_allocated += column.second.allocated;
+        profile.column_bytes_peak += column.second.samples.capacity();
+      }
+    }
+  }
+}
+
+
+
+double APBinDecoder::get_decimation_rate(const std::string& msg_name, const double& duration) const
+{
+  for (const auto& rule : load_selection.decimation.rules)
+  {
+    if ( !matches({ rule.pattern }, msg_name) )
+    {
+      continue;
+    }
+
+    // each bucket publishes two samples, so the budget of points is reached at points / duration
+    double max_rate = rule.max_rate;
+    if ( rule.max_points > 0 )
+    {
+      const double budget_rate = static_cast<double>(rule.max_points) / duration;
+      max_rate = (max_rate > 0) ? std::min(max_rate, budget_rate) : budget_rate;
+    }
+    return max_rate;
+  }
+  return load_selection.decimation.max_rate;
+}
+
+
+
+bool APBinDecoder::get_decimation_buckets(const std::string& msg_name)
+{
+  decimation_buckets.clear();
+  const size_t rows = publish_times.size();
+  if ( rows < 3 )
+  {
+    return false;
+  }
+
+  const double duration = publish_times.back() - publish_times.front();
+  if ( !(duration > 0) )
+  {
+    return false;
+  }
+  const double max_rate = get_decimation_rate(msg_name, duration);
+  if ( !(max_rate > 0) || static_cast<double>(rows - 1) / duration <= max_rate )
+  {
+    return false;
+  }
+
+  // each bucket publishes two samples, a jump back in time starts a new bucket
+  const double bucket_duration = 2.0 / max_rate;
+  double bucket_begin = publish_times[0];
+  decimation_buckets.push_back(0);
+  for (size_t i = 1; i < rows; i++)
+  {
+    const double& time = publish_times[i];
+    if ( time >= bucket_begin + bucket_duration || time < bucket_begin )
+    {
+      decimation_buckets.push_back(i);
+      bucket_begin = time;
+    }
+  }
+  decimation_buckets.push_back(rows);
+  return true;
+}
+
+
+
+void APBinDecoder::publish_decimated(const typed_column& column, APBinSink& sink, void* series)
+{
+  // the column is converted once, so that the search of each bucket runs over contiguous doubles
+  publish_values.resize(column.size());
+  column.convert_all(publish_values.data());
+  const double* values = publish_values.data();
+
+  // the extreme values of a bucket are reduced first, a second scan finds their first rows
+  //  - NaN values are kept: the first NaN of a bucket is published next to its minimum and maximum
+  decimation_rows.clear();
+  for (size_t bucket = 0; bucket + 1 < decimation_buckets.size(); bucket++)
+  {
+    const size_t begin = decimation_buckets[bucket];
+    const size_t end = decimation_buckets[bucket + 1];
+
+    double min_value;
+    double max_value;
+    const bool has_nan = find_extremes(values, begin, end, min_value, max_value);
+    const bool has_values = ( min_value <= max_value );
+
+    // the first rows of the extremes, a NaN is rare and searched without vector instructions
+    size_t min_row = end;
+    size_t max_row = end;
+    size_t nan_row = end;
+    if ( has_values )
+    {
+      min_row = find_row(values, begin, end, min_value);
+      max_row = find_row(values, begin, end, max_value);
+    }
+    if ( has_nan )
+    {
+      for (nan_row = begin; !std::isnan(values[nan_row]); nan_row++) {}
+    }
+
+    // the samples keep their order in time (unused rows are end, they are sorted behind the others)
+    size_t rows[3] = { min_row, max_row, nan_row };
+    std::sort(rows, rows + 3);
+    for (size_t idx = 0; idx < 3 && rows[idx] != end; idx++)
+    {
+      if ( idx == 0 || rows[idx] != rows[idx - 1] )
+      {
+        decimation_rows.push_back(rows[idx]);
+      }
+    }
+  }
+
+  // the kept samples are gathered into a block, which is appended at once
+  const size_t samples = decimation_rows.size();
+  decimated_times.resize(samples);
+  decimated_values.resize(samples);
+  for (size_t i = 0; i < samples; i++)
+  {
+    decimated_times[i] = publish_times[decimation_rows[i]];
+    decimated_values[i] = values[decimation_rows[i]];
+  }
+  sink.append(series, decimated_times.data(), decimated_values.data(), samples);
+}
+
+
+
+bool APBinDecoder::get_window_range(const uint64_t& len, uint64_t& begin, uint64_t& end)
+{
+  const time_window& load_window = load_selection.window;
+  if ( !load_window.enabled || time_index.empty() )
+  {
+    return false;
+  }
+
+  // the time index is in boot time
+  double start = load_window.start;
+  double stop = load_window.end;
+  if ( load_window.utc )
+  {
+    if ( !time_offset_folded )
+    {
+      std::fprintf(stderr, "WARNING: time window is given in GPS time, but the logfile can not be synchronized! Loading the whole logfile!\n");
+      return false;
+    }
+    start -= folded_time_offset;
+    stop -= folded_time_offset;
+  }
+  if ( stop < start )
+  {
+    std::fprintf(stderr, "WARNING: time window ends before it starts! Loading the whole logfile!\n");
+    return false;
+  }
+
+  // the byte range starts at the last checkpoint before the window and ends at the first checkpoint behind it,
+  // so up to TIME_INDEX_STEP bytes around the window are decoded as well
+  begin = 0;
+  end = len;
+  for (const auto& checkpoint : time_index)
+  {
+    const double& time = checkpoint.time;
+    if ( time > stop )
+    {
+      end = checkpoint.offset;
+      break;
+    }
+    if ( time <= start )
+    {
+      begin = checkpoint.offset;
+    }
+  }
+
+  std::printf("Loading time window %.3f s to %.3f s (bytes %" PRIu64 " to %" PRIu64 ")\n", start, stop, begin, end);
+  return true;
+}
+
+
+
+void APBinDecoder::add_decode_chunk(const uint64_t& offset)
+{
+  // the previous chunk ends where the new one begins
+  if ( !decode_chunks.empty() )
+  {
+    decode_chunks.back().end = offset;
+  }
+
+  parse_context chunk;
+  chunk.pass = parse_pass::DECODE_CHUNK;
+  chunk.final_definitions = true;
+  chunk.begin = offset;
+
+  // the messages counted so far are the first rows of this chunk
+  for (uint32_t idx = 0; idx < message_counts.size(); idx++)
+  {
+    if ( message_counts[idx] > 0 )
+    {
+      chunk.first_rows.emplace_back(idx, message_counts[idx]);
+    }
+  }
+
+  decode_chunks.push_back(std::move(chunk));
+}
+
+
+
+bool APBinDecoder::decode_parallel(const uint8_t* buf, const uint64_t& len, const int& thread_count, parse_statistics& stats)
+{
+  // allocate all columns in their final size, every chunk fills its own rows
+  for (uint32_t idx = 0; idx < message_counts.size(); idx++)
+  {
+    const uint32_t samples = message_counts[idx];
+    if ( samples == 0 )
+    {
+      continue;
+    }
+    const uint8_t msg_id = idx / MAX_INSTANCES;
+    const uint8_t instance = idx % MAX_INSTANCES;
+
+    std::unique_ptr<message_instances>& instances = messages_store[msg_id];
+    if ( !instances )
+    {
+      instances.reset(new message_instances());
+    }
+    std::unique_ptr<message_data> msg_data(new message_data(create_message_data(formats[msg_id], samples)));
+    for (const auto& field : decode_plans[msg_id].fields)
+    {
+      (*msg_data)[field.column].second.resize(samples);
+    }
+    (*instances)[instance] = std::move(msg_data);
+  }
+
+  // all workers add their progress to the byte counter of the pass
+  begin_pass_progress(PRESCAN_PROGRESS, 100, decode_chunks.back().end - decode_chunks.front().begin);
+  for (auto& chunk : decode_chunks)
+  {
+    chunk.bytes_parsed = &pass_bytes;
+  }
+
+  // the workers take the next chunk, until all chunks are decoded
+  //  - the first failure of a worker (e.g. std::bad_alloc) stops the other workers at their next progress step,
+  //    it is rethrown on the thread of the load (like a failure of the serial decoding)
+  std::atomic<size_t> next_chunk{ 0 };
+  std::exception_ptr worker_error;
+  std::mutex worker_error_mutex;
+  const int worker_count = std::min(thread_count, static_cast<int>(decode_chunks.size()));
+  std::vector<std::thread> workers;
+  for (int worker = 0; worker < worker_count; worker++)
+  {
+    workers.emplace_back([this, buf, len, &next_chunk, &worker_error, &worker_error_mutex]()
+    {
+      try
+      {
+        for (size_t idx = next_chunk++; idx < decode_chunks.size(); idx = next_chunk++)
+        {
+          parse_messages(buf, len, decode_chunks[idx]);
+        }
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(worker_error_mutex);
+        if ( !worker_error )
+        {
+          worker_error = std::current_exception();
+        }
+        next_chunk = decode_chunks.size();
+        cancel_requested = true;
+      }
+    });
+  }
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  if ( worker_error )
+  {
+    cancel_requested = false;
+    std::rethrow_exception(worker_error);
+  }
+  if ( cancel_requested )
+  {
+    return false;
+  }
+
+  // sum up the statistics of all chunks
+  for (const auto& chunk : decode_chunks)
+  {
+    merge_statistics(stats, chunk.stats);
+  }
+
+  return true;
+}
+
+
+
+void APBinDecoder::merge_statistics(parse_statistics& stats, const parse_statistics& chunk_stats)
+{
+  stats.msgs_skipped += chunk_stats.msgs_skipped;
+  stats.msgs_outside_window += chunk_stats.msgs_outside_window;
+  stats.msgs_read += chunk_stats.msgs_read;
+  stats.fmt_ms += chunk_stats.fmt_ms;
+  stats.fmtu_ms += chunk_stats.fmtu_ms;
+  stats.mult_ms += chunk_stats.mult_ms;
+  stats.unit_ms += chunk_stats.unit_ms;
+  stats.other_ms += chunk_stats.other_ms;
+
+  for (size_t msg_id = 0; msg_id < MAX_FORMATS; msg_id++)
+  {
+    message_counters& counters = stats.messages[msg_id];
+    const message_counters& chunk_counters = chunk_stats.messages[msg_id];
+    counters.bytes += chunk_counters.bytes;
+    counters.messages += chunk_counters.messages;
+    counters.skipped += chunk_counters.skipped;
+    counters.outside_window += chunk_counters.outside_window;
+    counters.decoded += chunk_counters.decoded;
+    counters.sampled += chunk_counters.sampled;
+    counters.sampled_time += chunk_counters.sampled_time;
+  }
+
+  // a region at the end of a chunk may continue in the next chunk (the skipped bytes of dropped regions are counted too)
+  const uint64_t bytes_skipped = stats.bytes_skipped + chunk_stats.bytes_skipped;
+  for (const auto& region : chunk_stats.skipped_regions)
+  {
+    stats.skip(region.offset, region.length);
+  }
+  stats.bytes_skipped = bytes_skipped;
+  stats.skipped_regions_dropped += chunk_stats.skipped_regions_dropped;
+  if ( chunk_stats.skipped_regions_dropped > 0 )
+  {
+    stats.dropped_region_end = chunk_stats.dropped_region_end;
+  }
+}
+
+
+
+// read a field of type T from the raw message and convert it to double
+//  - memcpy is used, because fields in the packed messages are not aligned
+template <typename T>
+static double read_field(const uint8_t* field)
+{
+  T value;
+  memcpy(&value, field, sizeof(T));
+  return static_cast<double>(value);
+}
+
+// same as read_field for all samples of a column, the samples are stored without gaps (see typed_column)
+//  - a single loop without calls, which the compiler can vectorize
+template <typename T>
+static void read_column(const uint8_t* samples, const size_t& count, const double& scale, const double& shift,
+                        double* values)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    T value;
+    memcpy(&value, samples + i * sizeof(T), sizeof(T));
+    values[i] = static_cast<double>(value) * scale + shift;
+  }
+}
+
+
+
+void APBinDecoder::compile_decode_plan(const uint8_t& msg_id, const size_t& label_count)
+{
+  const struct log_Format& fmt = formats[msg_id];
+  decode_plan& plan = decode_plans[msg_id];
+  plan = decode_plan();
+
+  // only fields with a label are decoded
+  const size_t format_length = strnlen(fmt.format, MAX_FORMAT_SIZE);
+  const size_t field_count = std::min(format_length, label_count);
+
+  uint32_t msg_offset = LOG_PACKET_HEADER_LEN;  // discard header
+
+  /*
+    If you need to change this section, please also fix logformat.h (format_types)!
+    AP_Logger: Format Types (https://github.com/ArduPilot/ardupilot/tree/master/libraries/AP_Logger#format-types)
+      - file: libraries/AP_Logger/LogStructure.h (commit: b80cc9a)
+      - line: 9 - 28
+  */
+  for (size_t i = 0; i < field_count; i++)
+  {
+    const char typeCode = fmt.format[i];
+    field_converter convert = nullptr;
+    column_converter convert_column = nullptr;
+    switch (typeCode)
+    {
+      case 'a':   // not used, that is for ISBD
+      case 'n':   // not used, that is for MSG or PARAM
+      case 'N':   // not used, that is for MSG or PARAM
+      case 'Z':   // not used, that is for MSG or PARAM
+        plan.skip_mask |= (1u << i);
+        break;
+      case 'b':
+        convert = &read_field<int8_t>;
+        convert_column = &read_column<int8_t>;
+        break;
+      case 'B':
+      case 'M':
+        convert = &read_field<uint8_t>;
+        convert_column = &read_column<uint8_t>;
+        break;
+      case 'h':
+      case 'c':
+        convert = &read_field<int16_t>;
+        convert_column = &read_column<int16_t>;
+        break;
+      case 'H':
+      case 'C':
+        convert = &read_field<uint16_t>;
+        convert_column = &read_column<uint16_t>;
+        break;
+      case 'i':
+      case 'e':
+      case 'L':
+        convert = &read_field<int32_t>;
+        convert_column = &read_column<int32_t>;
+        break;
+      case 'I':
+      case 'E':
+        convert = &read_field<uint32_t>;
+        convert_column = &read_column<uint32_t>;
+        break;
+      case 'f':
+        convert = &read_field<float>;
+        convert_column = &read_column<float>;
+        break;
+      case 'd':
+        convert = &read_field<double>;
+        convert_column = &read_column<double>;
+        break;
+      case 'q':
+        convert = &read_field<int64_t>;
+        convert_column = &read_column<int64_t>;
+        break;
+      case 'Q':
+        convert = &read_field<uint64_t>;
+        convert_column = &read_column<uint64_t>;
+        break;
+      default:
+        std::fprintf(stderr, "ERROR: format type '%c' is not defined! Message %u can not be decoded!\n", typeCode, msg_id);
+        // At this point the field offset is unknown, therefore we can not proceed to interpret the remaining fields!
+        return;
+    }
+
+    if (convert != nullptr)
+    {
+      plan.fields.push_back({ static_cast<uint16_t>(msg_offset), static_cast<uint8_t>(i),
+                              static_cast<uint8_t>(format_types.at(typeCode)), convert, convert_column, 1.0, -0.0 });
+    }
+    msg_offset += format_types.at(typeCode);
+  }
+
+  // never read beyond the end of a message
+  if (msg_offset > fmt.length)
+  {
+    std::fprintf(stderr, "ERROR: format of message %u is longer than its length! Message can not be decoded!\n", msg_id);
+    return;
+  }
+
+  // the TimeUS field is the timestamp of all other fields, if it is decoded (a label beyond the format is not)
+  const auto labels_it = field_name2idx.find(msg_id2name[msg_id]);
+  if ( labels_it != field_name2idx.end() )
+  {
+    const auto time_idx_it = labels_it->second.find("TimeUS");
+    if ( time_idx_it != labels_it->second.end() &&
+         std::any_of(plan.fields.begin(), plan.fields.end(),
+                     [&](const field_decoder& field) { return field.column == time_idx_it->second; }) )
+    {
+      plan.time_column = time_idx_it->second;
+    }
+  }
+
+  plan.valid = true;
+  apply_folding(msg_id);
+}
+
+
+
+void APBinDecoder::apply_folding(const uint8_t& msg_id)
+{
+  decode_plan& plan = decode_plans[msg_id];
+
+  // only the TimeUS field is shifted
+  const int time_idx = plan.time_column;
+
+  for (auto& field : plan.fields)
+  {
+    field.scale = multipliers_folded ? field_scales[msg_id][field.column] : 1.0;
+
+    // -0.0 is the additive identity for every value (+0.0 would turn -0.0 into +0.0)
+    field.shift = (time_offset_folded && field.column == time_idx) ? folded_time_offset : -0.0;
+  }
+}
+
+
+
+void APBinDecoder::fold_multipliers(void)
+{
+  // the multipliers of all messages counted by the pre-scan are folded into their decode plans
+  for (uint16_t msg_id = 0; msg_id < MAX_FORMATS; msg_id++)
+  {
+    std::fill(std::begin(field_scales[msg_id]), std::end(field_scales[msg_id]), 1.0);
+
+    const auto counts_begin = message_counts.begin() + msg_id * MAX_INSTANCES;
+    if ( std::all_of(counts_begin, counts_begin + MAX_INSTANCES, [](uint32_t count) { return count == 0; }) )
+    {
+      continue;
+    }
+
+    // check if FMTU exists
+    if ( !has_fmtu[msg_id] )
+    {
+      std::fprintf(stderr, "WARNING: No FMTU for message %s found. Can not apply multipliers!\n", msg_id2name[msg_id].c_str());
+      continue;
+    }
+
+    for (const auto& field : decode_plans[msg_id].fields)
+    {
+      field_scales[msg_id][field.column] = get_multiplier(msg_id, field.column);
+    }
+  }
+
+  multipliers_folded = true;
+}
+
+
+
+void APBinDecoder::fold_time_offset(void)
+{
+  // the time offset of apply_timesync is only known in advance, if the reference is decoded with the final definitions
+  if ( !definitions_stable || !has_gps_reference )
+  {
+    return;
+  }
+
+  // decode the needed fields of the reference message
+  const uint8_t msg_id = static_cast<uint8_t>(gps_msg_id);
+  const uint8_t* msg = gps_reference_msg.data();
+  auto decode_field = [&](const uint8_t& column, double& value)
+  {
+    for (const auto& field : decode_plans[msg_id].fields)
+    {
+      if ( field.column == column )
+      {
+        value = field.convert(msg + field.offset) * field_scales[msg_id][column];
+        return true;
+      }
+    }
+    return false;
+  };
+
+  double log_time{ 0 };
+  double gps_week{ 0 };
+  double gps_ms{ 0 };
+  if ( !decode_field(field_name2idx["GPS"]["TimeUS"], log_time) ||
+       !decode_field(field_name2idx["GPS"]["GWk"], gps_week) ||   // GWk -> GPS week
+       !decode_field(field_name2idx["GPS"]["GMS"], gps_ms) )      // GMS -> GPS seconds in week (ms)
+  {
+    return;
+  }
+
+  folded_time_offset = get_time_offset(log_time, gps_week, gps_ms);
+  time_offset_folded = true;
+}
+
+
+
+void APBinDecoder::fold_live_multipliers(const uint8_t& msg_id)
+{
+  // same as fold_multipliers, but only for one message with the definitions received so far
+  if ( !has_fmtu[msg_id] )
+  {
+    std::fprintf(stderr, "WARNING: No FMTU for message %s found. Can not apply multipliers!\n", msg_id2name[msg_id].c_str());
+  }
+  else
+  {
+    for (const auto& field : decode_plans[msg_id].fields)
+    {
+      field_scales[msg_id][field.column] = get_multiplier(msg_id, field.column);
+    }
+  }
+  apply_folding(msg_id);
+
+  // the series names contain the processed units (units, which are already processed, stay unchanged)
+  process_units();
+}
+
+
+
+APBinDecoder::msg_handler APBinDecoder::select_message_handler(const uint8_t& msg_id, const std::string& msg_name)
+{
+  // messages which define the content of other messages
+  if ( msg_name == "FMTU" )
+  {
+    return msg_handler::FMTU;
+  }
+  if ( msg_name == "MULT" )
+  {
+    return msg_handler::MULT;
+  }
+  if ( msg_name == "UNIT" )
+  {
+    return msg_handler::UNIT;
+  }
+
+  // discard messages that should not be used or can not be decoded
+  if ( skipped_messages.count(msg_name) > 0 || !decode_plans[msg_id].valid )
+  {
+    return msg_handler::SKIP;
+  }
+
+  // discard messages that were not selected (after the pre-scan)
+  if ( selection_active && !matches(load_selection.messages, msg_name) )
+  {
+    return msg_handler::SKIP;
+  }
+
+  return msg_handler::DATA;
+}
+
+
+
+void APBinDecoder::handle_message_received(const struct log_Format& fmt, const uint8_t* msg)
+{
+  // message id
+  const uint8_t& msg_id = fmt.type;
+
+  // instances
+  uint8_t instance = 0;
+  if ( has_instance[msg_id] )
+  {
+    instance = get_instance(fmt, msg);
+  }
+
+  // get message_data of the message id and instance, create it on first use
+  std::unique_ptr<message_instances>& instances = messages_store[msg_id];
+  if ( !instances )
+  {
+    instances.reset(new message_instances());
+
+    // resuming: the multipliers of a message, which was not in the last load, are not folded yet
+    if ( resuming )
+    {
+      fold_live_multipliers(msg_id);
+    }
+  }
+  std::unique_ptr<message_data>& msg_data_ptr = (*instances)[instance];
+  if ( !msg_data_ptr )
+  {
+    const size_t samples = message_counts.empty() ? 0 : message_counts[msg_id * MAX_INSTANCES + instance];
+    msg_data_ptr.reset(new message_data(create_message_data(fmt, samples)));
+  }
+  message_data& msg_data = *msg_data_ptr;
+
+  // run the decode plan, the fields are stored in their native width
+  for (const auto& field : decode_plans[msg_id].fields)
+  {
+    msg_data[field.column].second.push_back(msg + field.offset);
+  }
+}
+
+
+
+void APBinDecoder::handle_message_received(const struct log_Format& fmt, const uint8_t* msg, std::vector<uint32_t>& rows)
+{
+  // message id
+  const uint8_t& msg_id = fmt.type;
+
+  // instances
+  uint8_t instance = 0;
+  if ( has_instance[msg_id] )
+  {
+    instance = get_instance(fmt, msg);
+  }
+
+  // the columns were allocated before the parallel decoding was started (see decode_parallel)
+  message_data& msg_data = *(*messages_store[msg_id])[instance];
+  const uint32_t row = rows[msg_id * MAX_INSTANCES + instance]++;
+
+  // run the decode plan, the fields are stored in their native width
+  for (const auto& field : decode_plans[msg_id].fields)
+  {
+    msg_data[field.column].second.set(row, msg + field.offset);
+  }
+}
+
+
+
+void APBinDecoder::handle_message_received(const struct log_Format& fmt, const uint8_t* msg, APBinSink& sink)
+{
+  // message id
+  const uint8_t& msg_id = fmt.type;
+  const decode_plan& plan = decode_plans[msg_id];
+
+  // instances
+  uint8_t instance = 0;
+  if ( has_instance[msg_id] )
+  {
+    instance = get_instance(fmt, msg);
+  }
+
+  // get the series of the message id and instance, create them on first use
+  std::unique_ptr<series_instances>& instances = series_store[msg_id];
+  if ( !instances )
+  {
+    instances.reset(new series_instances());
+
+    // live decoding: the definitions of the message are complete, when its first message arrives
+    if ( live_decoding )
+    {
+      fold_live_multipliers(msg_id);
+    }
+
+    // only publish messages, which have the "TimeUS" field!
+    if ( plan.time_column < 0 )
+    {
+      std::printf("Ignoring message '%s' because it has no 'TimeUS' field!\n", msg_id2name[msg_id].c_str());
+    }
+  }
+  if ( plan.time_column < 0 )
+  {
+    return;
+  }
+
+  std::vector<void*>& series = (*instances)[instance];
+  if ( series.empty() )
+  {
+    // same series as published from the messages_store (all labels, but not the timestamp, instance and undecoded fields)
+    const message_data labels = create_message_data(fmt, 0);
+    series.resize(labels.size(), nullptr);
+    for (size_t idx = 0; idx < labels.size(); idx++)
+    {
+      if ( static_cast<int>(idx) == plan.time_column ||
+           ( has_instance[msg_id] && (static_cast<int>(idx) == instance_idx[msg_id]) ) ||
+           ( plan.skip_mask & (1u << idx) ) )
+      {
+        continue;
+      }
+      series[idx] = sink.add_series(msg_id2name[msg_id], get_series_name(msg_id, instance, idx));
+    }
+  }
+
+  // run the decode plan
+  double values[MAX_FORMAT_SIZE];
+  for (const auto& field : plan.fields)
+  {
+    values[field.column] = field.convert(msg + field.offset) * field.scale + field.shift;
+  }
+
+  const double& msg_time = values[plan.time_column];
+  for (const auto& field : plan.fields)
+  {
+    if ( series[field.column] != nullptr )
+    {
+      sink.append(series[field.column], msg_time, values[field.column]);
+    }
+  }
+}
+
+
+
+APBinDecoder::message_data APBinDecoder::create_message_data(const struct log_Format& fmt, const size_t& samples)
+{
+  const std::string labels(fmt.labels, strnlen(fmt.labels, MAX_LABELS_SIZE));
+
+  // split labels at delimiter ",", empty labels are kept, so that the columns match the fields
+  message_data msg_data;
+  size_t begin = 0;
+  while ( !labels.empty() )
+  {
+    const size_t end = labels.find(',', begin);
+    msg_data.emplace_back(labels.substr(begin, end - begin), typed_column());
+    if ( end == std::string::npos )
+    {
+      break;
+    }
+    begin = end + 1;
+  }
+
+  // the columns of decoded fields take the type and the folding of the decode plan, all other fields stay empty
+  for (const auto& field : decode_plans[fmt.type].fields)
+  {
+    if ( field.column >= msg_data.size() )
+    {
+      continue;
+    }
+    typed_column& column = msg_data[field.column].second;
+    column.width = field.width;
+    column.convert = field.convert;
+    column.convert_column = field.convert_column;
+    column.scale = field.scale;
+    column.shift = field.shift;
+    column.reserve(samples);
+  }
+  return msg_data;
+}
+
+
+
+uint32_t APBinDecoder::get_field_byte_offset(const uint8_t& msg_id, const uint8_t& field_idx)
+{
+  // check if FMT exists
+  if ( !has_fmt[msg_id])
+  {
+    // raise error, because fmt does not exist!
+    std::fprintf(stderr, "ERROR: FMT for message %u does not exist!\n", msg_id);
+    exit(EXIT_FAILURE);
+  }
+
+  // get information from FMT
+  const struct log_Format& fmt = formats[msg_id];
+  const char* format = fmt.format;
+
+  // calculate offsets:
+
+  // - header offset
+  uint32_t header_offset = LOG_PACKET_HEADER_LEN;
+
+  // - data offset
+  uint32_t data_offset = 0;
+  for (uint8_t idx = 0; idx < field_idx; idx++)
+  {
+    const auto format_types_it = format_types.find(format[idx]);
+    if ( format_types_it == format_types.end() )
+    {
+      // raise error, because format type definition is missing
+      std::fprintf(stderr, "ERROR: format type '%c' is not defined!\n", format[idx]);
+      exit(EXIT_FAILURE);
+    }
+    data_offset += format_types_it->second;
+  }
+
+  uint32_t total_offset = header_offset + data_offset;
+
+  return total_offset;
+}
+
+
+
+uint32_t APBinDecoder::get_field_byte_offset(const uint8_t& msg_id, const std::string& field_name)
+{
+  const std::string& msg_name = msg_id2name[msg_id];
+  const uint8_t field_idx = field_name2idx[msg_name][field_name];
+
+  return get_field_byte_offset(msg_id, field_idx);
+}
+
+
+
+uint8_t APBinDecoder::get_instance(const struct log_Format& fmt, const uint8_t* msg)
+{
+  // Read sensor instance from raw message byte sequence
+
+  // get message id from FMT
+  const uint8_t& msg_id = fmt.type;
+  
+  // get instance byte offset
+  const uint32_t& inst_offset = instance_offset[msg_id];
+
+  // get instance
+  uint8_t instance{ 0 };
+  memcpy(&instance, &msg[inst_offset], sizeof(uint8_t));
+
+  return instance;
+}
+
+
+
+std::string APBinDecoder::get_unit(const uint8_t& msg_id, const size_t& column)
+{
+  const std::string& msg_name = msg_id2name[msg_id];
+
+  // check if FMTU exists
+  if ( !has_fmtu[msg_id] )
+  {
+    std::fprintf(stderr, "\nWARNING: no FMTU for message %s found! Can not apply units!\n", msg_name.c_str());
+    return "";
+  }
+
+  // get unit descriptor char
+  const char& unit_char = format_units[msg_id].units[column];
+
+  // get unit string 
+  const auto& unit_it = units.find(unit_char);
+  if ( unit_it == units.end() )
+  {
+    std::fprintf(stderr, "WARNING: No unit for unit-id %c found! Can not apply unit in message: %s\n", unit_char, msg_name.c_str());
+    return "";
+  }
+
+  return unit_it->second;
+}
+
+
+
+const std::string& APBinDecoder::get_series_name(const uint8_t& msg_id, const uint8_t& instance, const size_t& column)
+{
+  // the message part and the field parts are built once per message id, the units are looked up once per field
+  std::unique_ptr<series_names>& names = series_names_store[msg_id];
+  if ( !names )
+  {
+    names.reset(new series_names());
+    names->msg_part = "/" + msg_id2name[msg_id];
+
+    const message_data labels = create_message_data(formats[msg_id], 0);
+    names->field_parts.reserve(labels.size());
+    for (size_t idx = 0; idx < labels.size(); idx++)
+    {
+      std::string field_part = "/" + labels[idx].first;
+
+      #ifdef LABEL_WITH_UNIT
+        const std::string unit_str = get_unit(msg_id, idx);
+        if ( !unit_str.empty() )
+        {
+          field_part += "\t[" + unit_str + "]";
+        }
+      #endif
+
+      names->field_parts.push_back(std::move(field_part));
+    }
+  }
+
+  // the names of all fields of an instance are built at once
+  std::vector<std::string>& instance_names = names->names[instance];
+  if ( instance_names.empty() )
+  {
+    const std::string instance_part = has_instance[msg_id] ? "/#" + std::to_string(instance) : std::string();
+    instance_names.reserve(names->field_parts.size());
+    for (const std::string& field_part : names->field_parts)
+    {
+      instance_names.push_back(names->msg_part + instance_part + field_part);
+    }
+  }
+
+  return instance_names[column];
+}
+
+
+
+uint64_t APBinDecoder::get_decoded_size(void)
+{
+  uint64_t decoded_size = 0;
+  for (uint32_t idx = 0; idx < message_counts.size(); idx++)
+  {
+    const uint8_t msg_id = idx / MAX_INSTANCES;
+    decoded_size += static_cast<uint64_t>(message_counts[idx]) * decode_plans[msg_id].fields.size() * sizeof(double);
+  }
+  return decoded_size;
+}
+
+
+
+void APBinDecoder::process_units(void)
+{
+  // - convert '/<unit>' spelling because it's incompatible with PlotJuggler
+  //    - PlotJuggler uses '/' in names for data splitting into subtopics
+  const std::string superscript_minus = "⁻";
+  const std::array<std::string, 3> superscript_numbers = {"¹", "²", "³"};
+
+  for (auto& unit_it : units)
+  {
+    std::string& unit = unit_it.second;
+
+    std::map<std::string, uint8_t> counter;
+
+    size_t pos = 0;
+    while ( (pos = unit.find("/")) != std::string::npos )
+    {
+      std::string token = unit.substr(pos+1, 1);
+
+      // push to map
+      auto counter_it = counter.find(token);
+      if (counter_it == counter.end())
+      {
+        counter[token] = 0;
+      }
+      else
+      {
+        counter[token]++;
+      }
+      
+      // erase old '/<unit>' from string
+      unit.erase(pos, pos + 1);
+    }
+
+    // append new style to string
+    for (auto& counter_it : counter)
+    {
+      unit.append(" " + counter_it.first + superscript_minus + superscript_numbers[counter_it.second]);
+    }
+  }
+}
+
+
+
+void APBinDecoder::publish_instance(const message_data& msg_data, const size_t& time_idx, const std::string& msg_name,
+                                    const std::vector<const std::string*>& series_names, APBinSink& sink)
+{
+  // convert the timestamps once, they are shared by all fields of the message instance
+  const typed_column& timestamps = msg_data[time_idx].second;
+  publish_times.resize(timestamps.size());
+  timestamps.convert_all(publish_times.data());
+
+  // high-rate message instances are decimated
+  const bool decimate = load_selection.decimation.enabled && get_decimation_buckets(msg_name);
+
+  // the series of all fields are added before their samples are appended (see APBinSink)
+  publish_series.assign(msg_data.size(), nullptr);
+  for (size_t idx = 0; idx < msg_data.size(); idx++)
+  {
+    if ( series_names[idx] != nullptr )
+    {
+      publish_series[idx] = sink.add_series(msg_name, *series_names[idx]);
+    }
+  }
+
+  if ( decimate )
+  {
+    for (size_t idx = 0; idx < msg_data.size(); idx++)
+    {
+      if ( publish_series[idx] != nullptr )
+      {
+        publish_decimated(msg_data[idx].second, sink, publish_series[idx]);
+      }
+    }
+    return;
+  }
+
+  // the columns are converted into blocks, which are appended at once (a chunk of rows of all columns after another)
+  const size_t rows = publish_times.size();
+  const size_t chunk_rows = (publish_chunk_rows > 0) ? publish_chunk_rows : rows;
+  size_t first = 0;
+  do
+  {
+    const size_t samples = std::min(chunk_rows, rows - first);
+    publish_values.resize(samples);
+    for (size_t idx = 0; idx < msg_data.size(); idx++)
+    {
+      void* series = publish_series[idx];
+      if ( series == nullptr )
+      {
+        continue;
+      }
+      msg_data[idx].second.convert_rows(first, samples, publish_values.data());
+      sink.append(series, publish_times.data() + first, publish_values.data(), samples);
+    }
+    first += samples;
+  }
+  while ( first < rows );
+}
+
+
+
+void APBinDecoder::retire_message(const uint8_t& msg_id)
+{
+  std::unique_ptr<message_instances>& instances = messages_store[msg_id];
+  if ( !instances )
+  {
+    return;
+  }
+
+  // only messages, which have a decoded "TimeUS" field, are published
+  const std::string& msg_name = msg_id2name[msg_id];
+  if ( decode_plans[msg_id].time_column < 0 )
+  {
+    instances.reset();
+    return;
+  }
+
+  // the series names contain the processed units of the previous layout
+  process_units();
+
+  retired_message retired;
+  retired.msg_name = msg_name;
+  retired.time_column = decode_plans[msg_id].time_column;
+  retired.series_names.resize(MAX_INSTANCES);
+  for (uint16_t instance = 0; instance < MAX_INSTANCES; instance++)
+  {
+    std::unique_ptr<message_data>& msg_data = (*instances)[instance];
+    if ( !msg_data )
+    {
+      continue;
+    }
+    const size_t rows = (*msg_data)[retired.time_column].second.size();
+    if ( rows == 0 )
+    {
+      msg_data.reset();
+      continue;
+    }
+
+    // the columns of the new layout are reserved for the remaining messages of the pre-scan (see create_message_data)
+    if ( !message_counts.empty() )
+    {
+      uint32_t& count = message_counts[msg_id * MAX_INSTANCES + instance];
+      count -= std::min<uint32_t>(count, static_cast<uint32_t>(rows));
+    }
+
+    // the timestamp, the instance and the undecoded fields are not published
+    std::vector<std::string>& names = retired.series_names[instance];
+    names.resize(msg_data->size());
+    for (size_t idx = 0; idx < msg_data->size(); idx++)
+    {
+      if ( idx == retired.time_column || ( has_instance[msg_id] && (static_cast<int>(idx) == instance_idx[msg_id]) ) ||
+           ( decode_plans[msg_id].skip_mask & (1u << idx) ) )
+      {
+        continue;
+      }
+      names[idx] = get_series_name(msg_id, instance, idx);
+    }
+  }
+  retired.instances = std::move(instances);
+  retired_messages.push_back(std::move(retired));
+}
+
+
+
+double APBinDecoder::get_multiplier(const uint8_t& msg_id, const uint8_t& field_idx)
+{
+  // get multiplier descriptor char
+  const char& field_multiplier_char = format_units[msg_id].multipliers[field_idx];
+
+  // get multiplier double
+  const auto multiplier_it = multipliers.find(field_multiplier_char);
+  if ( multiplier_it == multipliers.end() )
+  {
+    std::fprintf(stderr, "WARNING: No multiplier for multiplier-id %c found! Can not apply multiplier in message: %s\n", field_multiplier_char, msg_id2name[msg_id].c_str());
+    return 1.0;
+  }
+  const double field_multiplier = multiplier_it->second;
+
+  // check if multiplier is 0 or 1
+  if ( is_nearly(field_multiplier, 0) || is_nearly(field_multiplier, 1) )
+  {
+    return 1.0;
+  }
+
+  return field_multiplier;
+}
+
+
+
+double APBinDecoder::get_time_offset(const double& log_time, const double& gps_week, const double& gps_ms)
+{
+  // constant time offset variables
+  static constexpr double GPS2UNIX_TIME_OFFSET = 315964800;   // time offset between unix and gps time
+  static constexpr double GPS2UNIX_LEAP_SECONDS = -18;        // additional time offset due to leap seconds (must be adjusted if number of leap seconds changes!)
+  static constexpr double SECONDS_PER_WEEK = 604800;          // number of seconds per week
+
+  const double gps_week_seconds = gps_ms * 0.001;
+
+  const double unix_time = gps_week * SECONDS_PER_WEEK + gps_week_seconds + GPS2UNIX_TIME_OFFSET + GPS2UNIX_LEAP_SECONDS;
+
+  return unix_time - log_time;
+}
+
+
+
+void APBinDecoder::apply_timesync(void)
+{
+  // ArduPilot logs should be comparable with rosbags, therefore the same time basis is needed...
+  //  - rosbag:         unix time
+  //  - ArduPilot log:  local time since power on
+  //    -> the logged GNSS time can be used for synchronisation
+
+  // extract GNSS time
+  const auto msg_it = msg_name2id.find("GPS");
+  if ( msg_it == msg_name2id.end() || !messages_store[msg_it->second] || !(*messages_store[msg_it->second])[0] )
+  {
+    std::printf("Skipping timesync because the logfile does not contain GNSS data\n");
+    return;
+  }
+
+  // take the first instance as reference
+  // todo: change that?
+  const message_data& gps_msg_data = *(*messages_store[msg_it->second])[0];
+
+  // get needed field indexes
+  const auto& gps_time_idx = field_name2idx["GPS"]["TimeUS"];
+  const auto& gps_week_idx = field_name2idx["GPS"]["GWk"]; // GWk -> GPS week
+  const auto& gps_ms_idx = field_name2idx["GPS"]["GMS"];   // GMS -> GPS seconds in week (ms)
+
+  // the second GNSS sample is used as reference
+  if ( gps_msg_data[gps_time_idx].second.size() < 2 )
+  {
+    std::printf("Skipping timesync because the logfile does not contain enough GNSS data\n");
+    return;
+  }
+
+  const double gps_week = gps_msg_data[gps_week_idx].second[1];
+  const double gps_ms = gps_msg_data[gps_ms_idx].second[1];
+  const double log_time = gps_msg_data[gps_time_idx].second[1];
+
+  const double time_offset = get_time_offset(log_time, gps_week, gps_ms);
+
+
+  // iterate through messages
+  for (uint16_t msg_id = 0; msg_id < MAX_FORMATS; msg_id++)
+  {
+    if ( !messages_store[msg_id] )
+    {
+      continue;
+    }
+
+    if ( decode_plans[msg_id].time_column < 0 )
+    {
+      continue;
+    }
+    const size_t time_idx = decode_plans[msg_id].time_column;
+
+    // iterate through instances
+    message_instances& instances = *messages_store[msg_id];
+    for (auto& msg_data_ptr : instances)
+    {
+      if ( !msg_data_ptr )
+      {
+        continue;
+      }
+
+      // add time offset
+      message_data& msg_data = *msg_data_ptr;
+
+      msg_data[time_idx].second.shift += time_offset;
+    }
+  }
+  for (auto& retired : retired_messages)
+  {
+    for (auto& msg_data_ptr : *retired.instances)
+    {
+      if ( msg_data_ptr )
+      {
+        (*msg_data_ptr)[retired.time_column].second.shift += time_offset;
+      }
+    }
+  }
+
+  // messages, which are decoded later (see resume), get the time offset from their decode plans
+  folded_time_offset = time_offset;
+  time_offset_folded = true;
+  for (uint16_t msg_id = 0; msg_id < MAX_FORMATS; msg_id++)
+  {
+    apply_folding(msg_id);
+  }
+}
@@ -0,0 +1,866 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Decoder of ArduPilot DataFlash binaries without any dependency on Qt or PlotJuggler,
+ * shared by the plotjuggler plugin and headless tools.
+ * The logic is derived from Dronekit-La software (https://github.com/dronekit/dronekit-la).
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "logformat.h"
+
+
+// destination of the decoded series
+//  - add_series is called once per series before its first sample, the returned handle is passed to append
+//    (nullptr: the series is not published)
+//  - the series of all fields of a message instance are added together, before any of their samples is appended
+//  - the samples of a series are appended in the order of the logfile, all fields of a message instance share
+//    their timestamps (with direct publishing message by message, otherwise series by series or in chunks of rows,
+//    see APBinDecoder::set_publish_chunk_rows)
+//  - a series is added again, if its message was redefined with another layout in the logfile, the samples of the
+//    new layout continue the series of the same name
+//  - all calls are made from the thread, which runs APBinDecoder::decode
+class APBinSink
+{
+public:
+  virtual ~APBinSink() = default;
+
+  virtual void* add_series(const std::string& msg_name, const std::string& series_name) = 0;
+
+  virtual void append(void* series, const double& time, const double& value) = 0;
+
+  virtual void append(void* series, const double* times, const double* values, const size_t& count)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      append(series, times[i], values[i]);
+    }
+  }
+};
+
+
+// source of a logfile, which is read front to back instead of being mapped (e.g. decompressed on the fly)
+//  - the decoder reads the logfile twice (pre-scan and decode pass), rewind starts again at its beginning
+//  - all calls of a pass are made from a producer thread of APBinDecoder::decode, which fills the buffers of the decode loop
+class APBinSource
+{
+public:
+  virtual ~APBinSource() = default;
+
+  // start again at the beginning of the logfile, returns false on failure (see get_error)
+  virtual bool rewind(void) = 0;
+
+  // read up to size bytes into buf, returns the number of bytes read (0: end of the logfile or failure, see get_error)
+  virtual size_t read(uint8_t* buf, const size_t& size) = 0;
+
+  // progress of the source: consumed and total bytes of the underlying file (e.g. the compressed logfile)
+  virtual uint64_t get_position(void) const = 0;
+  virtual uint64_t get_size(void) const = 0;
+
+  // description of the last failure (empty, if there was none)
+  virtual std::string get_error(void) const = 0;
+};
+
+
+class APBinDecoder
+{
+public:
+  // metadata of a message type (from the pre-scan)
+  struct message_info
+  {
+    std::string name;
+    int instances;
+    uint64_t samples;
+  };
+
+  // time range of the logfile (from the pre-scan)
+  struct time_range
+  {
+    double first = 0;         // first timestamp (boot time in seconds)
+    double last = 0;          // last timestamp (boot time in seconds)
+    bool has_utc = false;     // indicator, if the GPS time of the logfile is known
+    double utc_offset = 0;    // offset between GPS time (UTC, unix time) and boot time
+  };
+
+  // time window to load
+  struct time_window
+  {
+    bool enabled = false;
+    bool utc = false;         // indicator, if start and end are given in GPS time (UTC, unix time) instead of boot time
+    double start = 0;         // seconds
+    double end = 0;           // seconds
+  };
+
+  // decimation of high-rate messages
+  //  - the first rule, which matches a message, replaces max_rate for its instances: a rate, a budget of points per
+  //    series or both (the lower rate applies), a rule without both keeps all samples of the message
+  struct decimation_rule
+  {
+    std::string pattern;        // message name or wildcard pattern (see matches)
+    double max_rate = 0;        // maximum rate (Hz), 0: none
+    uint64_t max_points = 0;    // maximum number of points of a series, 0: none
+  };
+  struct decimation_settings
+  {
+    bool enabled = false;
+    double max_rate = 100;    // messages above this rate (Hz) are reduced to the minimum and maximum of each bucket
+    std::vector<decimation_rule> rules;
+  };
+
+  // messages (names or wildcard patterns), time window and decimation of a load
+  struct selection
+  {
+    std::vector<std::string> messages = { "*" };
+    time_window window;
+    decimation_settings decimation;
+  };
+
+  // hooks of a load (called on the thread of the load)
+  //  - select_messages:  called after the pre-scan with all messages and the time range of the logfile,
+  //                      may change the selection, the load stops if it returns false
+  struct load_hooks
+  {
+    std::function<bool(const std::vector<message_info>&, const time_range&, selection&)> select_messages =
+        [](const std::vector<message_info>&, const time_range&, selection&) { return true; };
+  };
+
+  // profile of a message type in the decode pass
+  //  - messages and bytes count every complete message of the type, skipped ones are stepped over (selection),
+  //    outside_window ones lie in front of the time window
+  //  - decode_ms is extrapolated from every PROFILE_SAMPLE_INTERVAL-th decoded message, so the clock is rarely read
+  struct message_profile
+  {
+    std::string name;
+    uint8_t msg_id = 0;
+    uint64_t bytes = 0;
+    uint64_t messages = 0;
+    uint64_t skipped = 0;
+    uint64_t outside_window = 0;
+    double decode_ms = 0;
+  };
+
+  // region of the logfile, which holds no valid message (corrupted data, messages without FMT or truncated end)
+  struct skipped_region
+  {
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    double time = 0;    // time of the closest checkpoint in front of the region (boot time, or GPS time if it is folded)
+  };
+
+  // profile of a load, always collected by the decode pass
+  //  - adjacent skipped bytes are merged into one region, only the first MAX_SKIPPED_REGIONS regions are kept
+  //  - column memory: allocated bytes of all decoded columns and their size before publishing (0 for a direct publish)
+  struct load_profile
+  {
+    std::vector<message_profile> messages;        // message types with at least one message, ordered by message id
+    std::vector<skipped_region> skipped_regions;
+    uint64_t skipped_regions_dropped = 0;         // number of regions, which were not kept
+    uint64_t column_bytes_allocated = 0;
+    uint64_t column_bytes_peak = 0;
+    double start_time = 0;                        // time of the first checkpoint (same time base as the regions)
+  };
+
+  // report of a load: runtime of each phase (ms), statistics and profile of the decode pass
+  struct load_report
+  {
+    double prescan_ms = 0;        // pre-scan and folding (without the message selection)
+    double decode_ms = 0;         // decode pass (including the publishing of a direct publish)
+    double postprocess_ms = 0;    // units, multipliers and timesync, which were not folded into the decode plans
+    double publish_ms = 0;        // copy of the decoded columns into the series
+    uint64_t bytes = 0;
+    uint64_t bytes_skipped = 0;
+    uint32_t msgs_read = 0;
+    uint32_t msgs_skipped = 0;
+    uint32_t msgs_outside_window = 0;  // messages in front of the time window, which were stepped over
+    bool parallel = false;        // indicator, if the chunks were decoded in parallel
+    bool direct_publish = false;  // indicator, if the samples were published directly
+    load_profile profile;
+
+    // export the report as JSON (e.g. for comparing logfiles outside of the tools)
+    std::string to_json(void) const;
+  };
+
+  // decode a mapped logfile into the sink
+  //  - the load may run on any thread, its progress is polled with get_progress and it is stopped with cancel
+  //  - returns false, if loading was canceled
+  //  - a failure of a decoding or producer thread (e.g. std::bad_alloc) is rethrown on the thread of the load
+  bool decode(const uint8_t* buf, const uint64_t& len, APBinSink& sink, load_hooks& hooks, load_report& report);
+
+  // decode a logfile, which is streamed from the source, into the sink
+  //  - the source is read on a producer thread into buffers of a fixed size, the whole logfile is never held in memory
+  //  - the logfile is decoded serially
+  //  - returns false, if loading was canceled
+  bool decode(APBinSource& source, APBinSink& sink, load_hooks& hooks, load_report& report);
+
+  // progress of the running load in percent (0 - 100), may be called from any thread
+  int get_progress(void) const;
+
+  // cancel the running load, may be called from any thread
+  //  - the load stops at its next progress step (see PROGRESS_STEP), a cancel in front of a load stops it right away
+  void cancel(void)
+  {
+    cancel_requested = true;
+  }
+
+  // set the selection of the next load (the select_messages hook may still change it)
+  void set_selection(const selection& selection)
+  {
+    load_selection = selection;
+  }
+  const selection& get_selection(void) const
+  {
+    return load_selection;
+  }
+
+  // set the number of threads of the parallel decoding (0: number of hardware threads)
+  void set_thread_count(const int& count)
+  {
+    thread_count_limit = count;
+  }
+
+  // publish the decoded samples directly, whenever the definitions allow it (not only for logfiles which exceed the memory)
+  //  - the sink receives the samples message by message in the order of the logfile, the messages_store is not built
+  //  - the logfile is decoded serially then
+  void set_direct_publish(const bool& enabled)
+  {
+    prefer_direct_publish = enabled;
+  }
+
+  // publish the stored samples of a message instance in chunks of rows, all fields of a chunk before the next chunk
+  //  - a sink, which writes rows, only buffers a chunk per message instance then (0: field by field, default)
+  //  - decimated message instances are published field by field
+  void set_publish_chunk_rows(const size_t& rows)
+  {
+    publish_chunk_rows = rows;
+  }
+
+  // resume the last load of a logfile, which has grown since (e.g. a SITL logfile or a logfile on a network share)
+  //  - only the appended bytes are decoded, with the definitions and into the decoded columns of the last load
+  //  - all series are published again, they replace the series of the last load
+  //  - can_resume checks, if the last load was a mapped logfile without time window and without direct publishing and
+  //    the logfile still starts with the same bytes, otherwise the logfile needs a full load
+  //  - returns false, if loading was canceled (the next load must be a full load then)
+  bool can_resume(const uint8_t* buf, const uint64_t& len) const;
+  bool resume(const uint8_t* buf, const uint64_t& len, APBinSink& sink, load_report& report);
+
+  // check if the last load can be resumed (the logfile is not checked, see can_resume)
+  bool is_resumable(void) const
+  {
+    return resumable;
+  }
+
+  // free the decoded columns, which are kept after a load for resuming it (the load can not be resumed afterwards)
+  //  - the kept columns hold the whole decoded logfile in the native width of its fields, next to the published series
+  void release_decoded_data(void);
+
+  // live decoding of a logfile, which is still being written (e.g. a followed file or a UDP stream)
+  //  - begin_live starts a new logfile, decode_live decodes the appended bytes into the sink right away
+  //  - the definitions are kept across the calls, a message which is not complete yet is decoded by the next call
+  //  - there is no pre-scan: the messages are selected by the patterns of the selection (no time window or decimation),
+  //    the multipliers of a message are folded when its first message arrives and the timestamps stay in boot time
+  //  - returns the number of decoded messages
+  void begin_live(void);
+  uint64_t decode_live(const uint8_t* buf, const size_t& len, APBinSink& sink);
+
+  // statistics and load profile of the live decoding since begin_live (without phases and column memory)
+  void get_live_report(load_report& report) const;
+
+  // all messages and the time range of the last loaded logfile (pre-scan)
+  const std::vector<message_info>& get_messages(void) const
+  {
+    return logfile_messages;
+  }
+  const time_range& get_time_range(void) const
+  {
+    return logfile_time_range;
+  }
+
+  // indicator, if the series names contain the units of the fields (LABEL_WITH_UNIT)
+  static bool has_unit_labels(void);
+
+  // check if a message name matches one of the patterns (wildcards '*', '?' and '[...]' allowed)
+  static bool matches(const std::vector<std::string>& patterns, const std::string& name);
+
+private:
+  // multipliers and units from MULT and UNIT messages
+  std::map<char, double> multipliers;
+  std::map<char, std::string> units;
+
+
+  // format (FMT) and format unit (FMTU) handling variables
+  static constexpr uint16_t MAX_FORMATS = 256;
+  struct log_Format formats[MAX_FORMATS] = {};            // FMT
+  struct log_Format_Units format_units[MAX_FORMATS] = {}; // FMTU
+
+  bool has_fmt[MAX_FORMATS] = {false};    // indicator, if FMT for a given message id exists
+  bool has_fmtu[MAX_FORMATS] = {false};   // indicator, if FMTU for a given message id exists
+
+
+  // decode plan handling variables
+  //  - a decode plan is compiled once per message id when its FMT is parsed
+  //  - the plan holds the byte-offset, the column and a typed converter for each decoded field
+  //  - the decoded value is scaled and shifted: value * scale + shift (see apply_folding)
+  //  - fields which are not decoded (a, n, N, Z) are marked in the skip mask
+  //  - a decoded column is converted at once, when it is published (see column_converter)
+  typedef double (*field_converter)(const uint8_t* field);
+  typedef void (*column_converter)(const uint8_t* samples, const size_t& count, const double& scale, const double& shift,
+                                   double* values);
+  struct field_decoder
+  {
+    uint16_t offset;                  // byte-offset of the field in the message (including header)
+    uint8_t column;                   // index of the field in message_data
+    uint8_t width;                    // size of the field in bytes (see format_types)
+    field_converter convert;          // reads the field and converts it to double
+    column_converter convert_column;  // converts all samples of a column of this field
+    double scale;             // folded multiplier
+    double shift;             // folded time offset
+  };
+  struct decode_plan
+  {
+    bool valid = false;                 // indicator, if the message can be decoded
+    uint16_t skip_mask = 0;             // bit i is set, if field i is not decoded
+    int time_column = -1;               // index of the TimeUS field, -1 if the message has no TimeUS field
+    std::vector<field_decoder> fields;  // decoders of all decoded fields
+  };
+  decode_plan decode_plans[MAX_FORMATS] = {};
+
+
+  // typed_column holds the samples of a field in their native width (as stored in the logfile)
+  //  - a sample is converted to double, when it is published: convert(sample) * scale + shift
+  //  - publishing converts a whole column at once into a block of doubles (see convert_all)
+  //  - multipliers and the time offset, which are not folded into the decode plans, only change scale and shift
+  //  - fields which are not decoded have no width and stay empty
+  struct typed_column
+  {
+    uint8_t width = 0;
+    field_converter convert = nullptr;
+    column_converter convert_column = nullptr;
+    double scale = 1.0;
+    double shift = -0.0;
+    std::vector<uint8_t> samples;
+    uint64_t allocated = 0;   // bytes of all allocations of the samples (load profile)
+
+    size_t size() const
+    {
+      return (width == 0) ? 0 : samples.size() / width;
+    }
+    void reserve(const size_t& count)
+    {
+      const size_t capacity = samples.capacity();
+      samples.reserve(count * width);
+      count_allocation(capacity);
+    }
+    void resize(const size_t& count)
+    {
+      const size_t capacity = samples.capacity();
+      samples.resize(count * width);
+      count_allocation(capacity);
+    }
+    void push_back(const uint8_t* field)
+    {
+      const size_t capacity = samples.capacity();
+      samples.insert(samples.end(), field, field + width);
+      count_allocation(capacity);
+    }
+    void count_allocation(const size_t& previous_capacity)
+    {
+      if ( samples.capacity() != previous_capacity )
+      {
+        allocated += samples.capacity();
+      }
+    }
+    void set(const size_t& row, const uint8_t* field)
+    {
+      memcpy(&samples[row * width], field, width);
+    }
+    double operator[](const size_t& row) const
+    {
+      return convert(&samples[row * width]) * scale + shift;
+    }
+    void convert_all(double* values) const
+    {
+      convert_rows(0, size(), values);
+    }
+    void convert_rows(const size_t& first, const size_t& count, double* values) const
+    {
+      if ( width != 0 )
+      {
+        convert_column(samples.data() + first * width, count, scale, shift, values);
+      }
+    }
+  };
+
+
+  // message_data holds the data of a message for each timestamp
+  //  - std::string:  field name (label)
+  //  - typed_column: field data (fields)
+  typedef std::vector<std::pair<std::string, typed_column>> message_data;
+
+
+  // message dispatch handling variables
+  //  - the handler of a message id is selected once when its FMT is parsed
+  //  - the main loop dispatches each message with a single lookup in this table
+  enum class msg_handler : uint8_t
+  {
+    NONE,   // no FMT received for this message id
+    FMTU,   // format unit definition
+    MULT,   // multiplier definition
+    UNIT,   // unit definition
+    SKIP,   // discarded message (not selected or not decodable)
+    DATA    // decoded message
+  };
+  msg_handler handlers[MAX_FORMATS] = {};
+
+  // names of messages, which are discarded without decoding
+  std::set<std::string> skipped_messages = { "ISBD", "ISBH", "MSG", "PARM" };
+
+  // message selection handling variables
+  //  - after the pre-scan the messages to decode are selected (see select_messages)
+  //  - all other messages are discarded without decoding, like skipped_messages
+  //  - the selection consists of message names or wildcard patterns (e.g. "PID*")
+  selection load_selection;
+  bool selection_active = false;    // indicator, if the selection is applied (not in the pre-scan)
+  std::vector<message_info> logfile_messages;   // all messages of the logfile (pre-scan)
+
+
+  // time window handling variables
+  //  - the pre-scan records a sparse index of checkpoints (byte-offset and timestamp of a message)
+  //  - if a time window is selected, only the byte range between the checkpoints around it is decoded,
+  //    the definition messages are taken from the pre-scan (or replayed from the start, if they are not stable)
+  //  - the time window is given in boot time or in GPS time (UTC), which is mapped by the time offset of the timesync
+  struct time_checkpoint
+  {
+    uint64_t offset;    // byte-offset of the message
+    double time;        // boot time of the message in seconds (TimeUS is always in microseconds)
+  };
+  std::vector<time_checkpoint> time_index;
+  static constexpr uint64_t TIME_INDEX_STEP = 256 * 1024;   // distance between two checkpoints in bytes
+  time_range logfile_time_range;                            // time range of the logfile (pre-scan)
+
+
+  // decimation handling variables
+  //  - the series of a message instance above the maximum rate are split into time buckets of two samples at that rate,
+  //    only the minimum and the maximum sample of each bucket are published, so that spikes survive
+  //  - message instances at or below the maximum rate are published untouched
+  //  - the rows of the minimum and the maximum of each bucket are collected and appended to the series as one block
+  std::vector<size_t> decimation_buckets;       // first row of each bucket, followed by the number of rows
+  std::vector<size_t> decimation_rows;          // kept rows of a field in their order in time
+  std::vector<double> decimated_times;
+  std::vector<double> decimated_values;
+
+
+  // publish handling variables
+  //  - the timestamps of a message instance are converted once and shared by all of its fields
+  //  - the values of a field are converted into a block, which is appended to the sink at once
+  std::vector<double> publish_times;
+  std::vector<double> publish_values;
+  std::vector<void*> publish_series;    // series handle of each field of the message instance
+  size_t publish_chunk_rows = 0;        // rows of a published block (0: the whole column, see set_publish_chunk_rows)
+
+
+  // instance handling variables
+  bool has_instance[MAX_FORMATS] = {false};     // indicator, if a message contains intances
+  int instance_idx[MAX_FORMATS] = {-1};         // index of field, which contains the instance number
+  uint32_t instance_offset[MAX_FORMATS] = {0};  // byte-offset of field, which containts the instance number
+
+
+  // messages_store is a flat store which contains all messages
+  //  - index1: message id
+  //  - index2: instance number
+  //  - value:  message_data (nullptr, if no message with this id and instance was received)
+  //  - message names are only resolved when the data is published
+  static constexpr uint16_t MAX_INSTANCES = 256;
+  typedef std::array<std::unique_ptr<message_data>, MAX_INSTANCES> message_instances;
+  std::unique_ptr<message_instances> messages_store[MAX_FORMATS];
+
+
+  // multiplier and time offset folding variables
+  //  - after the pre-scan the final FMTU and MULT definitions are known, so the multiplier of each field
+  //    is folded into the decode plans (every load has a pre-scan, live decoding folds them per message)
+  //  - if the timesync reference (second GPS message of the first instance) is known after the pre-scan,
+  //    the time offset is folded into the TimeUS field, otherwise it is added afterwards (apply_timesync)
+  double field_scales[MAX_FORMATS][MAX_FORMAT_SIZE];
+  bool multipliers_folded = false;          // indicator, if field_scales are folded into the decode plans
+  double folded_time_offset = 0;
+  bool time_offset_folded = false;          // indicator, if folded_time_offset is folded into the decode plans
+  int16_t gps_msg_id = -1;                  // message id of GPS, -1 if there is no FMT for GPS
+  bool has_gps_reference = false;           // indicator, if the pre-scan found the timesync reference
+  std::vector<uint8_t> gps_reference_msg;   // copy of the timesync reference (a streamed logfile is not kept)
+
+
+  // pre-scan handling variables
+  //  - the logfile is parsed in two passes, the first pass only counts the messages of each message id and instance
+  //  - the columns are reserved with these counts in the decode pass, so they never reallocate
+  enum class parse_pass : uint8_t
+  {
+    COUNT,        // walk through all headers and count messages (pre-scan)
+    DECODE,       // decode all messages
+    DECODE_CHUNK, // decode the messages of a chunk with the final definitions of the pre-scan (parallel decoding)
+    PUBLISH,      // decode all messages with the final definitions of the pre-scan straight into the sink
+    LIVE          // decode the appended bytes of a growing logfile straight into the sink (see decode_live)
+  };
+  std::vector<uint32_t> message_counts;         // index: msg_id * MAX_INSTANCES + instance
+
+
+  // progress handling variables
+  //  - every pass adds its parsed bytes to an atomic byte counter in steps of PROGRESS_STEP and checks the cancel flag there,
+  //    so the parse loop does no progress math and does not call back into the caller
+  //  - a pass covers pass_from - pass_to percent of the load, get_progress scales the parsed bytes into this range
+  std::atomic<uint64_t> pass_bytes{ 0 };          // bytes parsed by the running pass (position of the source, if streamed)
+  std::atomic<uint64_t> pass_len{ 0 };            // bytes of the running pass (0: no pass is running)
+  std::atomic<int> pass_from{ 0 };
+  std::atomic<int> pass_to{ 0 };
+  std::atomic<bool> cancel_requested{ false };
+  static constexpr int PRESCAN_PROGRESS = 20;     // share of the pre-scan in the progress (%)
+  static constexpr uint64_t PROGRESS_STEP = 1024 * 1024;
+
+
+  // statistics of a parse pass
+  //  - the counters of each message type and the skipped regions are collected for the load profile (see load_profile)
+  struct message_counters
+  {
+    uint64_t bytes{ 0 };
+    uint64_t messages{ 0 };
+    uint64_t skipped{ 0 };
+    uint64_t outside_window{ 0 };
+    uint64_t decoded{ 0 };
+    uint64_t sampled{ 0 };                      // decoded messages, which were timed
+    std::chrono::nanoseconds sampled_time{ 0 };
+  };
+  static constexpr uint64_t PROFILE_SAMPLE_INTERVAL = 64;   // every n-th decoded message of a type is timed (power of 2)
+  static constexpr size_t MAX_SKIPPED_REGIONS = 1024;
+
+  struct parse_statistics
+  {
+    uint64_t bytes_skipped{ 0 };
+    uint32_t msgs_skipped{ 0 };
+    uint32_t msgs_outside_window{ 0 };
+    uint32_t msgs_read{ 0 };
+
+    std::array<message_counters, MAX_FORMATS> messages{};
+    std::vector<skipped_region> skipped_regions;
+    uint64_t skipped_regions_dropped{ 0 };
+    uint64_t dropped_region_end{ 0 };     // end of the last dropped region, which a following skip may continue
+
+    // count skipped bytes at the given byte-offset of the logfile
+    void skip(const uint64_t& offset, const uint64_t& length)
+    {
+      if ( length == 0 )
+      {
+        return;
+      }
+      bytes_skipped += length;
+      if ( !skipped_regions.empty() && skipped_regions.back().offset + skipped_regions.back().length == offset )
+      {
+        skipped_regions.back().length += length;
+      }
+      else if ( skipped_regions.size() < MAX_SKIPPED_REGIONS )
+      {
+        skipped_regions.push_back({ offset, length, 0 });
+      }
+      else
+      {
+        if ( offset != dropped_region_end )
+        {
+          skipped_regions_dropped++;
+        }
+        dropped_region_end = offset + length;
+      }
+    }
+
+    // runtime of the message handlers (only measured with DEBUG_RUNTIME)
+    std::chrono::duration<double, std::milli> fmt_ms{ 0 };
+    std::chrono::duration<double, std::milli> fmtu_ms{ 0 };
+    std::chrono::duration<double, std::milli> mult_ms{ 0 };
+    std::chrono::duration<double, std::milli> unit_ms{ 0 };
+    std::chrono::duration<double, std::milli> other_ms{ 0 };
+  };
+
+
+  // context of a parse pass
+  struct parse_context
+  {
+    parse_pass pass = parse_pass::DECODE;
+    uint64_t begin = 0;   // byte-offset at which parsing starts
+    uint64_t end = 0;     // byte-offset at which parsing stops (end of chunk or logfile)
+
+    // definition messages are only stepped over, because the final definitions of the pre-scan are used
+    bool final_definitions = false;
+
+    // time window: data messages in front of this byte-offset are stepped over without decoding
+    uint64_t data_begin = 0;
+
+    // pre-scan: byte-offset of the next checkpoint of the time index and the last message with a timestamp
+    uint64_t next_checkpoint = 0;
+    time_checkpoint last_checkpoint{ 0, 0 };
+    bool has_last_checkpoint = false;
+
+    // progress reporting: byte counter of the parsed bytes (see pass_bytes), all chunk workers share it
+    std::atomic<uint64_t>* bytes_parsed = nullptr;
+
+    // chunk workers: first row of each message id and instance (msg_id * MAX_INSTANCES + instance, row)
+    std::vector<std::pair<uint32_t, uint32_t>> first_rows;
+
+    // direct publishing: destination of the decoded samples
+    APBinSink* sink = nullptr;
+
+    // streaming: the parsed buffer holds a part of the logfile (see parse_stream)
+    //  - all recorded and compared byte-offsets are offsets in the logfile, which starts base bytes in front of the buffer
+    //  - a message at the end of the buffer, which is not complete, is left for the next buffer, if there is more input
+    //  - parsed is the byte-offset in the buffer, where the pass stopped
+    bool mapped = true;       // indicator, if the buffer is the mapped logfile (parsed pages are given back to the kernel)
+    uint64_t base = 0;
+    bool more_input = false;
+    uint64_t parsed = 0;
+    uint64_t stream_bytes = 0;  // number of bytes read from the source (length of the logfile, if it was read to its end)
+
+    parse_statistics stats;
+  };
+
+
+  // parallel decoding handling variables
+  //  - the pre-scan splits the logfile into chunks and records the first row of every message in each chunk
+  //  - all columns are allocated in their final size, the chunks are decoded on worker threads into their own rows
+  //  - this is only done, if no definition changes after a message of its id was parsed (see definitions_stable),
+  //    otherwise the logfile is decoded serially
+  std::vector<parse_context> decode_chunks;
+  uint64_t decode_chunk_size = 0;                 // 0: no parallel decoding
+  int thread_count_limit = 0;                     // number of worker threads (0: number of hardware threads)
+  bool definitions_stable = true;                 // indicator, if the final definitions are valid for the whole logfile
+  bool header_seen[MAX_FORMATS] = {false};        // indicator, if a header of a given message id was parsed
+  static constexpr uint64_t PARALLEL_MIN_SIZE = 16 * 1024 * 1024;   // smaller logfiles are decoded serially
+  static constexpr int CHUNKS_PER_THREAD = 4;                       // more chunks than threads balance the load
+
+
+  // streaming handling variables
+  //  - a producer thread reads the source into a ring of STREAM_BUFFER_COUNT buffers of STREAM_BUFFER_SIZE bytes
+  //  - each buffer keeps STREAM_CARRY bytes in front of its data, the beginning of a message, which straddles two
+  //    buffers, is copied there and completed by the next buffer (a message is never longer than 255 bytes)
+  static constexpr size_t STREAM_BUFFER_SIZE = 4 * 1024 * 1024;
+  static constexpr size_t STREAM_BUFFER_COUNT = 4;
+  static constexpr size_t STREAM_CARRY = 256;
+
+
+  // direct publishing handling variables
+  //  - the decoded samples are appended to the series of the sink right away, the messages_store is not built
+  //  - the series of a message id and instance are created when its first message is decoded
+  //  - this is only done, if the final definitions and the time offset are known after the pre-scan and
+  //    the messages_store would not fit into memory next to the series (or DIRECT_PUBLISH is defined)
+  //  - index1: message id
+  //  - index2: instance number
+  //  - value:  series handle of each field (nullptr, if the field is not published), empty if no message was received
+  typedef std::array<std::vector<void*>, MAX_INSTANCES> series_instances;
+  std::unique_ptr<series_instances> series_store[MAX_FORMATS];
+  static constexpr uint64_t DIRECT_PUBLISH_MEMORY_SHARE = 2;   // direct publishing above 1/2 of the physical memory
+  bool prefer_direct_publish = false;                          // direct publishing whenever possible (see set_direct_publish)
+
+
+  // series name handling variables
+  //  - the series names of a message id are built, when it is published first (its FMT, FMTU and UNIT definitions
+  //    are complete then), and kept until one of these definitions is parsed again
+  //  - the message part and the field parts (with their unit) are built once per message id, the names once per instance
+  //  - index: message id
+  struct series_names
+  {
+    std::string msg_part;                                     // "/<message>"
+    std::vector<std::string> field_parts;                     // "/<field>\t[<unit>]" of each column
+    std::array<std::vector<std::string>, MAX_INSTANCES> names;   // series name of each column, empty if not built yet
+  };
+  std::unique_ptr<series_names> series_names_store[MAX_FORMATS];
+
+
+  // resume handling variables
+  //  - after a load the byte-offset of the first incomplete message and hashes of the bytes in front of it are kept
+  //  - the hashes cover the first and the last RESUME_HASH_SIZE bytes in front of the resume point
+  bool resumable = false;
+  uint64_t resume_offset = 0;
+  uint64_t resume_head_hash = 0;
+  uint64_t resume_tail_hash = 0;
+  static constexpr uint64_t RESUME_HASH_SIZE = 64 * 1024;
+  bool resuming = false;    // indicator, if the appended bytes are decoded (messages of new ids fold their multipliers)
+
+  // record the resume point of a loaded logfile
+  void record_resume_point(const uint8_t* buf, const uint64_t& offset);
+
+
+  // live decoding handling variables
+  //  - the bytes of an incomplete message at the end of the appended bytes are kept for the next call
+  //  - live_offset is the byte-offset of the kept bytes in the logfile
+  bool live_decoding = false;
+  std::vector<uint8_t> live_buffer;
+  uint64_t live_offset = 0;
+  parse_statistics live_stats;
+
+
+  // redefinition handling variables
+  //  - a message id, which is redefined with another layout (e.g. concatenated logfiles of different firmware versions),
+  //    keeps the samples decoded with the previous layout, they are published in front of the samples of the new layout
+  //  - the series names are built at the redefinition, since the definitions of the previous layout are replaced
+  struct retired_message
+  {
+    std::string msg_name;
+    size_t time_column;                                   // column of the TimeUS field
+    std::unique_ptr<message_instances> instances;
+    std::vector<std::vector<std::string>> series_names;   // series name of each column of each instance (empty: not published)
+  };
+  std::vector<retired_message> retired_messages;
+
+
+  // message name <-> message id mapping
+  std::string msg_id2name[MAX_FORMATS] = {};
+  std::map<std::string, uint8_t> msg_name2id;
+
+
+  // field name <-> field idx mapping
+  std::map<std::string, std::map<std::string, uint8_t>> field_name2idx;
+
+
+  // reset all message definitions (FMT, FMTU, MULT, UNIT) and derived lookup tables
+  void reset_definitions(void);
+
+  // decode a mapped (buf) or streamed (source) logfile into the sink, see decode
+  //  - len is only known after the pre-scan for a streamed logfile
+  bool decode_logfile(const uint8_t* buf, uint64_t len, APBinSource* source, APBinSink& sink, load_hooks& hooks,
+                      load_report& report);
+
+  // parse the messages of the mapped logfile in the range of the parse context
+  //  - returns false, if loading was canceled
+  bool parse_messages(const uint8_t* buf, const uint64_t& len, parse_context& ctx);
+
+  // parse the messages of a streamed logfile in the range of the parse context (ctx.end: UINT64_MAX for the whole logfile)
+  //  - the source is read from its beginning, the buffers are parsed in order by parse_messages
+  //  - a failing source is handled like a truncated logfile
+  //  - returns false, if loading was canceled
+  bool parse_stream(APBinSource& source, parse_context& ctx);
+
+  // select the messages to decode from the messages counted by the pre-scan and apply the selection
+  //  - the select_messages hook may change the selection (the plugin asks the user or takes over a previous selection)
+  //  - returns false, if loading was canceled
+  bool select_messages(load_hooks& hooks);
+
+  // get a checkpoint of the time index for the message at the given byte-offset of the logfile
+  time_checkpoint get_time_checkpoint(const uint8_t* msg, const uint64_t& offset, const uint8_t& msg_id);
+
+  // determine the time range of the logfile from the time index (after the time offset is folded)
+  void update_time_range(void);
+
+  // get the time of the closest checkpoint of the time index in front of a byte-offset (GPS time, if it is folded)
+  double get_offset_time(const uint64_t& offset) const;
+
+  // build the load profile from the statistics of the decode pass and the decoded columns
+  void build_profile(const parse_statistics& stats, load_profile& profile) const;
+
+  // add the statistics of a chunk to the statistics of the decode pass (chunks in the order of the logfile)
+  static void merge_statistics(parse_statistics& stats, const parse_statistics& chunk_stats);
+
+  // get the maximum rate of a message, which spans the given duration (seconds), from the decimation rules
+  //  - returns 0, if the message is not decimated
+  double get_decimation_rate(const std::string& msg_name, const double& duration) const;
+
+  // split the rows of a message instance into the buckets of the decimation (see decimation_buckets)
+  //  - the timestamps of the message instance are taken from publish_times
+  //  - returns false, if the message instance is not above the maximum rate of its message
+  bool get_decimation_buckets(const std::string& msg_name);
+
+  // append the minimum and the maximum sample of each bucket of a field to a series (and the first NaN of the bucket)
+  void publish_decimated(const typed_column& column, APBinSink& sink, void* series);
+
+  // get the byte range of the logfile, which contains the selected time window
+  //  - returns false, if there is no time window to apply
+  bool get_window_range(const uint64_t& len, uint64_t& begin, uint64_t& end);
+
+  // start the progress of a pass, which covers from - to percent of the load and parses len bytes
+  void begin_pass_progress(const int& from, const int& to, const uint64_t& len);
+
+  // start a new chunk for parallel decoding at the given byte-offset (pre-scan)
+  void add_decode_chunk(const uint64_t& offset);
+
+  // decode all chunks of the pre-scan on worker threads
+  //  - returns false, if loading was canceled
+  bool decode_parallel(const uint8_t* buf, const uint64_t& len, const int& thread_count, parse_statistics& stats);
+
+  // compile the decode plan of a message from its FMT
+  void compile_decode_plan(const uint8_t& msg_id, const size_t& label_count);
+
+  // fold the multipliers and the time offset into the decode plan of a message
+  void apply_folding(const uint8_t& msg_id);
+
+  // determine the multiplier of all decoded fields from the final FMTU and MULT definitions (after pre-scan)
+  void fold_multipliers(void);
+
+  // determine the time offset from the timesync reference message (after pre-scan)
+  void fold_time_offset(void);
+
+  // fold the multipliers of a message from its current FMTU and MULT definitions (live decoding, resuming)
+  void fold_live_multipliers(const uint8_t& msg_id);
+
+  // select the handler of a message from its FMT
+  msg_handler select_message_handler(const uint8_t& msg_id, const std::string& msg_name);
+
+  // fill the message_data for a message according to its decode plan
+  //  - serial decoding appends the message to its columns
+  //  - parallel decoding writes the message to the next of its rows in the pre-allocated columns
+  //  - direct publishing appends the message to its series in the sink
+  void handle_message_received(const struct log_Format& fmt, const uint8_t* msg);
+  void handle_message_received(const struct log_Format& fmt, const uint8_t* msg, std::vector<uint32_t>& rows);
+  void handle_message_received(const struct log_Format& fmt, const uint8_t* msg, APBinSink& sink);
+
+  // publish all message instances of the messages_store (and of the retired_messages) to the sink
+  void publish_messages(APBinSink& sink);
+
+  // publish the columns of a message instance to the sink
+  //  - series_names holds the name of each column (nullptr: the column is not published)
+  void publish_instance(const message_data& msg_data, const size_t& time_idx, const std::string& msg_name,
+                        const std::vector<const std::string*>& series_names, APBinSink& sink);
+
+  // keep the decoded samples of a message, which is redefined with another layout (see retired_messages)
+  void retire_message(const uint8_t& msg_id);
+
+  // get the size of all decoded columns in the messages_store from the message counts of the pre-scan
+  uint64_t get_decoded_size(void);
+
+  // convert the units from UNIT messages into a spelling, which is compatible with plotjuggler
+  void process_units(void);
+
+  // get the series name of a field (see series name handling variables)
+  const std::string& get_series_name(const uint8_t& msg_id, const uint8_t& instance, const size_t& column);
+
+  // create message_data for a message, the decoded columns are reserved for the given number of samples
+  message_data create_message_data(const struct log_Format& fmt, const size_t& samples);
+
+  // get the byte offset of a field in a message
+  uint32_t get_field_byte_offset(const uint8_t& msg_id, const uint8_t& field_idx);
+  uint32_t get_field_byte_offset(const uint8_t& msg_id, const std::string& field_name);
+
+  // get the instance number from a message
+  uint8_t get_instance(const struct log_Format& fmt, const uint8_t* msg);
+
+  // get unit string for a field
+  std::string get_unit(const uint8_t& msg_id, const size_t& column);
+
+  // get the multiplier of a field from FMTU and MULT messages (1, if no multiplier needs to be applied)
+  double get_multiplier(const uint8_t& msg_id, const uint8_t& field_idx);
+
+  // get the offset between unix time and log time from the GNSS time of a GPS message
+  double get_time_offset(const double& log_time, const double& gps_week, const double& gps_ms);
+
+  // apply time synchronization to the messages_store (and the retired_messages)
+  void apply_timesync(void);
+};
@@ -0,0 +1,412 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Source of a compressed logfile, which is decompressed while it is decoded (see compressed_logfile.h).
+ *
+ */
+
+#include "compressed_logfile.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef WITH_LZ4
+#include <lz4frame.h>
+#endif
+
+
+// magic numbers of the compressed formats
+static constexpr uint8_t GZIP_MAGIC[] = { 0x1F, 0x8B };
+static constexpr uint8_t ZSTD_MAGIC[] = { 0x28, 0xB5, 0x2F, 0xFD };
+static constexpr uint8_t LZ4_MAGIC[] = { 0x04, 0x22, 0x4D, 0x18 };
+
+
+struct CompressedLogfile::streams
+{
+  #ifdef WITH_ZLIB
+    z_stream gzip{};
+    bool gzip_open = false;
+  #endif
+  #ifdef WITH_ZSTD
+    ZSTD_DCtx* zstd = nullptr;
+  #endif
+  #ifdef WITH_LZ4
+    LZ4F_dctx* lz4 = nullptr;
+  #endif
+  bool frame_open = false;    // indicator, if the current stream (frame) is not complete yet
+};
+
+
+
+CompressedLogfile::CompressedLogfile()
+  : state(new streams())
+{
+}
+
+
+
+CompressedLogfile::~CompressedLogfile()
+{
+  #ifdef WITH_ZLIB
+    if ( state->gzip_open )
+    {
+      inflateEnd(&state->gzip);
+    }
+  #endif
+  #ifdef WITH_ZSTD
+    ZSTD_freeDCtx(state->zstd);
+  #endif
+  #ifdef WITH_LZ4
+    if ( state->lz4 != nullptr )
+    {
+      LZ4F_freeDecompressionContext(state->lz4);
+    }
+  #endif
+}
+
+
+
+CompressedLogfile::compression CompressedLogfile::detect(const uint8_t* buf, const uint64_t& len)
+{
+  auto starts_with = [&](const uint8_t* magic, const size_t& size)
+  {
+    return len >= size && memcmp(buf, magic, size) == 0;
+  };
+
+  if ( starts_with(GZIP_MAGIC, sizeof(GZIP_MAGIC)) )
+  {
+    return compression::GZIP;
+  }
+  if ( starts_with(ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) )
+  {
+    return compression::ZSTD;
+  }
+  if ( starts_with(LZ4_MAGIC, sizeof(LZ4_MAGIC)) )
+  {
+    return compression::LZ4;
+  }
+  return compression::NONE;
+}
+
+
+
+bool CompressedLogfile::is_supported(const compression& type)
+{
+  switch (type)
+  {
+    case compression::GZIP:
+      #ifdef WITH_ZLIB
+        return true;
+      #else
+        return false;
+      #endif
+    case compression::ZSTD:
+      #ifdef WITH_ZSTD
+        return true;
+      #else
+        return false;
+      #endif
+    case compression::LZ4:
+      #ifdef WITH_LZ4
+        return true;
+      #else
+        return false;
+      #endif
+    case compression::NONE:
+    default:
+      return false;
+  }
+}
+
+
+
+const std::vector<const char*>& CompressedLogfile::get_extensions(void)
+{
+  static const std::vector<const char*> extensions = []()
+  {
+    std::vector<const char*> supported;
+    if ( is_supported(compression::GZIP) )
+    {
+      supported.push_back("gz");
+    }
+    if ( is_supported(compression::ZSTD) )
+    {
+      supported.push_back("zst");
+    }
+    if ( is_supported(compression::LZ4) )
+    {
+      supported.push_back("lz4");
+    }
+    return supported;
+  }();
+  return extensions;
+}
+
+
+
+const char* CompressedLogfile::get_name(const compression& type)
+{
+  switch (type)
+  {
+    case compression::GZIP:
+      return "gzip";
+    case compression::ZSTD:
+      return "zstd";
+    case compression::LZ4:
+      return "lz4";
+    case compression::NONE:
+    default:
+      return "none";
+  }
+}
+
+
+
+bool CompressedLogfile::open(const uint8_t* buf, const uint64_t& len)
+{
+  type = detect(buf, len);
+  if ( type == compression::NONE )
+  {
+    error = "the logfile is not compressed";
+    return false;
+  }
+  if ( !is_supported(type) )
+  {
+    error = std::string(get_name(type)) + " compression is not supported by this build";
+    return false;
+  }
+
+  in = buf;
+  in_len = len;
+  return rewind();
+}
+
+
+
+bool CompressedLogfile::rewind(void)
+{
+  in_pos = 0;
+  finished = false;
+  error.clear();
+  state->frame_open = false;
+
+  switch (type)
+  {
+    case compression::GZIP:
+      #ifdef WITH_ZLIB
+        if ( state->gzip_open )
+        {
+          inflateEnd(&state->gzip);
+          state->gzip_open = false;
+        }
+        state->gzip = z_stream{};
+        // 15 + 32: maximum window, gzip and zlib headers are detected automatically
+        if ( inflateInit2(&state->gzip, 15 + 32) != Z_OK )
+        {
+          error = "can not initialize zlib";
+          return false;
+        }
+        state->gzip_open = true;
+        return true;
+      #else
+        break;
+      #endif
+    case compression::ZSTD:
+      #ifdef WITH_ZSTD
+        if ( state->zstd == nullptr )
+        {
+          state->zstd = ZSTD_createDCtx();
+        }
+        if ( state->zstd == nullptr || ZSTD_isError(ZSTD_DCtx_reset(state->zstd, ZSTD_reset_session_only)) )
+        {
+          error = "can not initialize zstd";
+          return false;
+        }
+        return true;
+      #else
+        break;
+      #endif
+    case compression::LZ4:
+      #ifdef WITH_LZ4
+        if ( state->lz4 != nullptr )
+        {
+          LZ4F_freeDecompressionContext(state->lz4);
+          state->lz4 = nullptr;
+        }
+        if ( LZ4F_isError(LZ4F_createDecompressionContext(&state->lz4, LZ4F_VERSION)) )
+        {
+          state->lz4 = nullptr;
+          error = "can not initialize lz4";
+          return false;
+        }
+        return true;
+      #else
+        break;
+      #endif
+    case compression::NONE:
+    default:
+      break;
+  }
+
+  error = "no compressed logfile is open";
+  return false;
+}
+
+
+
+size_t CompressedLogfile::read(uint8_t* buf, const size_t& size)
+{
+  if ( finished || !error.empty() || size == 0 )
+  {
+    return 0;
+  }
+
+  size_t produced = 0;
+  switch (type)
+  {
+    case compression::GZIP:
+      produced = read_gzip(buf, size);
+      break;
+    case compression::ZSTD:
+      produced = read_zstd(buf, size);
+      break;
+    case compression::LZ4:
+      produced = read_lz4(buf, size);
+      break;
+    case compression::NONE:
+    default:
+      break;
+  }
+
+  // all input is consumed: the logfile ends, if the last stream is complete
+  if ( produced == 0 && error.empty() )
+  {
+    finished = true;
+    if ( state->frame_open )
+    {
+      error = "the compressed logfile is truncated";
+    }
+  }
+  return produced;
+}
+
+
+
+size_t CompressedLogfile::read_gzip(uint8_t* buf, const size_t& size)
+{
+  size_t produced = 0;
+  #ifdef WITH_ZLIB
+    z_stream& gzip = state->gzip;
+    while ( produced < size && in_pos < in_len )
+    {
+      // zlib counts in 32 bit
+      gzip.next_in = const_cast<Bytef*>(in + in_pos);
+      gzip.avail_in = static_cast<uInt>(std::min<uint64_t>(in_len - in_pos, UINT_MAX / 2));
+      gzip.next_out = buf + produced;
+      gzip.avail_out = static_cast<uInt>(std::min<size_t>(size - produced, UINT_MAX / 2));
+      const uInt avail_in = gzip.avail_in;
+      const uInt avail_out = gzip.avail_out;
+
+      const int ret = inflate(&gzip, Z_NO_FLUSH);
+      in_pos += avail_in - gzip.avail_in;
+      produced += avail_out - gzip.avail_out;
+
+      if ( ret == Z_STREAM_END )
+      {
+        // another stream may follow
+        state->frame_open = false;
+        inflateReset(&gzip);
+        continue;
+      }
+      if ( ret != Z_OK && ret != Z_BUF_ERROR )
+      {
+        error = (gzip.msg != nullptr) ? gzip.msg : "corrupted gzip data";
+        break;
+      }
+      state->frame_open = true;
+    }
+  #else
+    (void)buf;
+    (void)size;
+  #endif
+  return produced;
+}
+
+
+
+size_t CompressedLogfile::read_zstd(uint8_t* buf, const size_t& size)
+{
+  size_t produced = 0;
+  #ifdef WITH_ZSTD
+    ZSTD_inBuffer input{ in + in_pos, in_len - in_pos, 0 };
+    ZSTD_outBuffer output{ buf, size, 0 };
+    while ( output.pos < output.size )
+    {
+      const size_t in_before = input.pos;
+      const size_t out_before = output.pos;
+      const size_t ret = ZSTD_decompressStream(state->zstd, &output, &input);
+      if ( ZSTD_isError(ret) )
+      {
+        error = ZSTD_getErrorName(ret);
+        break;
+      }
+      if ( input.pos == in_before && output.pos == out_before )
+      {
+        break;
+      }
+
+      // 0: a frame is complete, another frame may follow
+      state->frame_open = (ret != 0);
+    }
+    in_pos += input.pos;
+    produced = output.pos;
+  #else
+    (void)buf;
+    (void)size;
+  #endif
+  return produced;
+}
+
+
+
+size_t CompressedLogfile::read_lz4(uint8_t* buf, const size_t& size)
+{
+  size_t produced = 0;
+  #ifdef WITH_LZ4
+    while ( produced < size )
+    {
+      size_t out_size = size - produced;
+      size_t in_size = in_len - in_pos;
+      const size_t ret = LZ4F_decompress(state->lz4, buf + produced, &out_size, in + in_pos, &in_size, nullptr);
+      if ( LZ4F_isError(ret) )
+      {
+        error = LZ4F_getErrorName(ret);
+        break;
+      }
+      in_pos += in_size;
+      produced += out_size;
+      if ( in_size == 0 && out_size == 0 )
+      {
+        break;
+      }
+
+      // 0: a frame is complete, another frame may follow
+      state->frame_open = (ret != 0);
+    }
+  #else
+    (void)buf;
+    (void)size;
+  #endif
+  return produced;
+}
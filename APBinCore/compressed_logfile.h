@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Source of a compressed logfile (.BIN.gz, .BIN.zst, .BIN.lz4), which is decompressed while it is decoded.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "apbin_decoder.h"
+
+
+// source of a mapped, compressed logfile, which is decompressed front to back (see APBinSource)
+//  - the compression is detected from the magic number, not from the file extension
+//  - a compression is only supported, if its library was found when building (see is_supported)
+//  - concatenated streams (e.g. of pigz or appended logfiles) are decompressed one after the other
+class CompressedLogfile : public APBinSource
+{
+public:
+  enum class compression : uint8_t
+  {
+    NONE,   // not compressed (or unknown)
+    GZIP,   // gzip, zlib
+    ZSTD,   // zstandard
+    LZ4     // lz4 frame format
+  };
+
+  CompressedLogfile();
+  CompressedLogfile(const CompressedLogfile&) = delete;
+  CompressedLogfile& operator=(const CompressedLogfile&) = delete;
+  ~CompressedLogfile() override;
+
+  // detect the compression of a logfile from its first bytes
+  static compression detect(const uint8_t* buf, const uint64_t& len);
+
+  // indicator, if a compression can be decompressed
+  static bool is_supported(const compression& type);
+
+  // file extensions of all supported compressions (e.g. "gz")
+  static const std::vector<const char*>& get_extensions(void);
+
+  // name of a compression (for messages)
+  static const char* get_name(const compression& type);
+
+  // decompress the mapped logfile, the mapping must stay valid until the logfile is decoded
+  //  - returns false, if the logfile is not compressed or the compression is not supported (see get_error)
+  bool open(const uint8_t* buf, const uint64_t& len);
+
+  bool rewind(void) override;
+  size_t read(uint8_t* buf, const size_t& size) override;
+
+  uint64_t get_position(void) const override
+  {
+    return in_pos;
+  }
+  uint64_t get_size(void) const override
+  {
+    return in_len;
+  }
+  std::string get_error(void) const override
+  {
+    return error;
+  }
+
+private:
+  compression type = compression::NONE;
+  const uint8_t* in = nullptr;    // mapped, compressed logfile
+  uint64_t in_len = 0;
+  uint64_t in_pos = 0;            // compressed bytes consumed
+  bool finished = false;          // indicator, if the last stream was decompressed completely
+  std::string error;
+
+  // state of the decompression libraries (see compressed_logfile.cpp)
+  struct streams;
+  std::unique_ptr<streams> state;
+
+  size_t read_gzip(uint8_t* buf, const size_t& size);
+  size_t read_zstd(uint8_t* buf, const size_t& size);
+  size_t read_lz4(uint8_t* buf, const size_t& size);
+};
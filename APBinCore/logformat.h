@@ -74,7 +74,7 @@ static constexpr uint8_t HEAD_BYTE2 = 0x95;    // Decimal 149
 
 
 /*
-  If you need to change this section, please also fix dataload_apbin.cpp (handle_message_received)!
+  If you need to change this section, please also fix dataload_apbin.cpp (compile_decode_plan)!
   AP_Logger: Format Types (https://github.com/ArduPilot/ardupilot/tree/master/libraries/AP_Logger#format-types)
     - file: libraries/AP_Logger/LogStructure.h (commit: b80cc9a)
     - line: 9 - 28
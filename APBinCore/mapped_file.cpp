@@ -0,0 +1,99 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Read-only mapping of a logfile for the headless tools (see mapped_file.h).
+ *
+ */
+
+#include "mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+
+
+bool MappedFile::open(const std::string& filename)
+{
+  close();
+
+  #if defined(__unix__) || defined(__APPLE__)
+    fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if ( fd < 0 || fstat(fd, &file_stat) != 0 )
+    {
+      error = std::strerror(errno);
+      close();
+      return false;
+    }
+    len = static_cast<uint64_t>(file_stat.st_size);
+
+    // an empty logfile can not be mapped, but is valid
+    if ( len == 0 )
+    {
+      return true;
+    }
+
+    void* mapping = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if ( mapping == MAP_FAILED )
+    {
+      error = std::strerror(errno);
+      close();
+      return false;
+    }
+    buf = static_cast<const uint8_t*>(mapping);
+  #else
+    std::ifstream file(filename, std::ios::binary);
+    if ( !file )
+    {
+      error = "can not open file";
+      return false;
+    }
+    content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    buf = content.data();
+    len = content.size();
+  #endif
+
+  return true;
+}
+
+
+
+void MappedFile::close(void)
+{
+  #if defined(__unix__) || defined(__APPLE__)
+    if ( buf != nullptr )
+    {
+      munmap(const_cast<uint8_t*>(buf), len);
+    }
+    if ( fd >= 0 )
+    {
+      ::close(fd);
+    }
+    fd = -1;
+  #else
+    content.clear();
+    content.shrink_to_fit();
+  #endif
+
+  buf = nullptr;
+  len = 0;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Read-only mapping of a logfile for the headless tools (the plugin maps logfiles with QFile).
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// read-only mapping of a logfile
+//  - the logfile is read into memory, if memory mapping is not available
+//  - the mapping is released, when the object is destroyed
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  // open and map a logfile, returns false on failure (see get_error)
+  bool open(const std::string& filename);
+
+  // release the mapping and close the logfile
+  void close(void);
+
+  const uint8_t* data(void) const
+  {
+    return buf;
+  }
+  uint64_t size(void) const
+  {
+    return len;
+  }
+  const std::string& get_error(void) const
+  {
+    return error;
+  }
+
+private:
+  const uint8_t* buf = nullptr;
+  uint64_t len = 0;
+  std::string error;
+
+  #if defined(__unix__) || defined(__APPLE__)
+    int fd = -1;
+  #else
+    std::vector<uint8_t> content;
+  #endif
+};
@@ -12,52 +12,115 @@
  */
 
 #include "dataload_apbin.h"
+#include "compressed_logfile.h"
 #include <QFile>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QProgressDialog>
 #include <QDateTime>
 #include <QInputDialog>
 #include <QElapsedTimer>
+#include <QEventLoop>
+#include <QThread>
+#include <QTimer>
 #include <QDebug>
-#include <chrono>
-#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <cinttypes>
+#include <set>
+#include <thread>
 
 
-// Debugging 
-//#define DEBUG_RUNTIME
-//#define DEBUG_MESSAGES
-//#define DEBUG_MULTIPLIERS
-//#define DEBUG_UNITS
+// Config
+//#define DECODED_CACHE     // cache the decoded logfile next to it (see decoded_cache.h)
+//#define LOADER_STATS      // publish the load profile as /_loader_stats/... series
+//#define INCREMENTAL_RELOAD  // keep the decoded columns of the last load to resume its reload (see APBinDecoder::resume)
 
 
-// Config
-//#define LABEL_WITH_UNIT
+DataLoadAPBIN::DataLoadAPBIN()
+{
+  extensions.push_back("BIN");  // TODO : this doesn't work for now as tolower() is hardcoded.
+
+  // compressed logfiles (e.g. .BIN.gz) are decompressed while they are decoded
+  for (const char* extension : CompressedLogfile::get_extensions())
+  {
+    extensions.push_back(extension);
+  }
+}
+
+const std::vector<const char*>& DataLoadAPBIN::compatibleFileExtensions() const
+{
+  return extensions;
+}
+
 
 
-bool is_nearly(double val, int val2)
+// convert a message selection between the decoder and the dialog
+static QStringList to_string_list(const std::vector<std::string>& messages)
 {
-  const double epsilon = 1e-10;
-  if (std::abs(val - val2) < epsilon)
+  QStringList list;
+  for (const std::string& message : messages)
   {
-    return true;
+    list.append(QString::fromStdString(message));
   }
-  else
+  return list;
+}
+
+static std::vector<std::string> to_std_vector(const QStringList& list)
+{
+  std::vector<std::string> messages;
+  for (const QString& message : list)
   {
-    return false;
+    messages.push_back(message.toStdString());
   }
+  return messages;
 }
 
 
-DataLoadAPBIN::DataLoadAPBIN()
+
+// name of a logfile without its compression extension and its last extension (e.g. flight.v2.BIN.gz -> flight.v2),
+// the same stem as the batch converter uses
+static std::string get_logfile_stem(const QString& logfile)
 {
-  extensions.push_back("BIN");  // TODO : this doesn't work for now as tolower() is hardcoded.
+  QString name = QFileInfo(logfile).fileName();
+  for (const char* extension : CompressedLogfile::get_extensions())
+  {
+    const QString suffix = QString(".") + extension;
+    if ( name.endsWith(suffix, Qt::CaseInsensitive) )
+    {
+      name.chop(suffix.size());
+      break;
+    }
+  }
+  return QFileInfo(name).completeBaseName().toStdString();
 }
 
-const std::vector<const char*>& DataLoadAPBIN::compatibleFileExtensions() const
+
+
+// print the summary of a load
+static void print_load_summary(const APBinDecoder::load_report& report)
 {
-  return extensions;
+  std::printf("\n  Read messages:\t%d", report.msgs_read);
+  std::printf("\n  Skipped messages:\t%d", report.msgs_skipped);
+  if ( report.msgs_outside_window > 0 )
+  {
+    std::printf("\n  Outside of window:\t%d", report.msgs_outside_window);
+  }
+  std::printf("\n  Skipped bytes:\t%" PRIu64 " from %" PRIu64 " bytes in %zu regions", report.bytes_skipped, report.bytes,
+              report.profile.skipped_regions.size() + report.profile.skipped_regions_dropped);
+  std::printf("\n  Column memory:\t%.1f MB\n", static_cast<double>(report.profile.column_bytes_peak) / (1024 * 1024));
+  for (const auto& message : report.profile.messages)
+  {
+    if ( message.decode_ms >= 1.0 )
+    {
+      std::printf("    %-6s %10" PRIu64 " messages %10.1f ms\n", message.name.c_str(), message.messages, message.decode_ms);
+    }
+  }
+  std::printf("\n");
 }
 
+
+
 bool DataLoadAPBIN::readDataFromFile(FileLoadInfo* info, PlotDataMapRef& plot_data)
 {
   QFile file(info->filename);
@@ -66,12 +129,36 @@ bool DataLoadAPBIN::readDataFromFile(FileLoadInfo* info, PlotDataMapRef& plot_da
     return false;
   }
 
-  const QByteArray file_array = file.readAll();
-  const int32_t file_size = file_array.size();
+  // the logfile is memory mapped instead of read into the heap:
+  //  - the parser works directly on the mapping, no copy of the whole logfile is held in memory
+  //  - all offsets are 64 bit, logfiles larger than 2 GiB are supported
+  const uint64_t file_size = static_cast<uint64_t>(file.size());
+  if (file_size == 0)
+  {
+    std::fprintf(stderr, "WARNING: logfile %s is empty!\n", info->filename.toLocal8Bit().constData());
+    return true;
+  }
+
+  const uint8_t* buf = file.map(0, static_cast<qint64>(file_size));
+  if (buf == nullptr)
+  {
+    std::fprintf(stderr, "ERROR: can not map logfile %s: %s\n", info->filename.toLocal8Bit().constData(),
+                 file.errorString().toLocal8Bit().constData());
+    return false;
+  }
+
+  const uint64_t len = file_size;
 
-  const uint8_t* buf = reinterpret_cast<const uint8_t*>(file_array.data());
-  const uint32_t len = file_array.size();
-  uint32_t total_bytes_used = 0;
+  // a compressed logfile is decompressed while it is decoded, the decompressed logfile is never held in memory
+  CompressedLogfile compressed;
+  const bool is_compressed = ( CompressedLogfile::detect(buf, len) != CompressedLogfile::compression::NONE );
+  if ( is_compressed && !compressed.open(buf, len) )
+  {
+    std::fprintf(stderr, "ERROR: can not decompress logfile %s: %s\n", info->filename.toLocal8Bit().constData(),
+                 compressed.get_error().c_str());
+    file.unmap(const_cast<uint8_t*>(buf));
+    return false;
+  }
 
   // Progress box for large file
   QProgressDialog progress_dialog;
@@ -82,947 +169,715 @@ bool DataLoadAPBIN::readDataFromFile(FileLoadInfo* info, PlotDataMapRef& plot_da
   progress_dialog.setAutoReset(true);
   progress_dialog.show();
 
-  int progress{ 0 };
-  int progress_update{ 0 };
-
-  uint32_t bytes_skipped{ 0 };
-  uint32_t msgs_skipped{ 0 };
-  uint32_t msgs_read{ 0 };
-
   QElapsedTimer timer;
   timer.start();
 
-  #ifdef DEBUG_RUNTIME
-    std::chrono::duration<double, std::milli> fmt_ms{ 0 };
-    std::chrono::duration<double, std::milli> fmtu_ms{ 0 };
-    std::chrono::duration<double, std::milli> mult_ms{ 0 };
-    std::chrono::duration<double, std::milli> unit_ms{ 0 };
-    std::chrono::duration<double, std::milli> other_ms{ 0 };
-    std::chrono::duration<double, std::milli> process_units_ms{ 0 };
-    std::chrono::duration<double, std::milli> apply_mult_ms{ 0 };
-    std::chrono::duration<double, std::milli> apply_tsync_ms{ 0 };
-    std::chrono::duration<double, std::milli> publish_ms{ 0 };
+  // a reload of the last loaded logfile with the same selection only decodes the bytes appended since the last load
+  //  - the decoder checks, that the logfile still starts with the bytes of the last load (see APBinDecoder::can_resume)
+  const bool resume = ( !is_compressed && info->filename == resumable_filename && additional_logfiles.empty() &&
+                        !info->selected_datasources.empty() &&
+                        to_std_vector(info->selected_datasources) == decoder.get_selection().messages &&
+                        decoder.can_resume(buf, len) );
+
+  #ifdef DECODED_CACHE
+    // -------------------- decoded cache -------------------- //
+    // a valid cache is published instead of decoding the logfile (resuming is faster, the series are kept in the decoder)
+    uint32_t cache_flags = 0;
+    if ( APBinDecoder::has_unit_labels() )
+    {
+      cache_flags |= CACHE_FLAG_LABEL_WITH_UNIT;
+    }
+    const DecodedCache::cache_key cache_key = DecodedCache::make_key(info->filename, buf, len, cache_flags);
+    cache_result cached = cache_result::MISSED;
+    cache_progress = -1;
+    cache_canceled = false;
   #endif
 
-  while (true)
+  // the logfile is decoded on a worker thread, so the GUI stays responsive while loading:
+  //  - the GUI thread polls the progress of the decoder and forwards a cancel of the progress dialog (see wait_for_load)
+  //  - the message selection is shown by the GUI thread, the worker waits for it
+  //  - further logfiles of the selection are loaded on their own worker threads, started with the selection
+  //  - the decoded cache is read before and written after decoding by the worker as well
+  //  - a failure of a worker (e.g. std::bad_alloc) cancels the other loads, it is rethrown here after all workers joined
+  series_prefix.clear();
+  additional_loads.clear();
+  APBinDecoder::load_hooks hooks;
+  hooks.select_messages = [this, info, &plot_data, &progress_dialog](const std::vector<APBinDecoder::message_info>& messages,
+                                                                     const APBinDecoder::time_range& range,
+                                                                     APBinDecoder::selection& selection)
   {
-    // update the progression dialog box
-    progress_update = static_cast<int>((static_cast<double>(total_bytes_used) / static_cast<double>(file_size)) * 100.0);
-    if ( (progress_update - 4) > progress )
+    bool selected = false;
+    QMetaObject::invokeMethod(&progress_dialog, [&]()
     {
-      progress = progress_update;
-      progress_dialog.setValue(progress);
-      QApplication::processEvents();
-      if (progress_dialog.wasCanceled())
+      selected = resolve_selection(info, messages, range, selection, progress_dialog);
+      if ( selected )
       {
-        return false;
+        start_additional_loads(info->filename, selection, plot_data);
       }
-    }
-
-    // check if end of file is reached
-    if (len - total_bytes_used < LOG_PACKET_HEADER_LEN)
-    {
-      progress_dialog.setValue(100);
-      bytes_skipped += len - total_bytes_used;
-      break;
-    }
-
-    // detect message start sequence (header)
-    // skip through input until we find a valid header:
-    if (buf[total_bytes_used] != HEAD_BYTE1 || buf[total_bytes_used + 1] != HEAD_BYTE2)
-    {
-      total_bytes_used += 1;
-      bytes_skipped += 1;
-      continue;
-    }
-
-    // get message-id from header
-    const uint8_t type = buf[total_bytes_used + 2];
-
-
-    // -------------------- handle FMT-message -------------------- //
-    if (type == LOG_FORMAT_MSG)
+    }, Qt::BlockingQueuedConnection);
+    return selected;
+  };
+
+  APBinDecoder::load_report report;
+  bool loaded = false;
+  std::exception_ptr load_error;
+  std::atomic<bool> finished{ false };
+  std::thread worker([&]()
+  {
+    try
     {
-      #ifdef DEBUG_RUNTIME
-        auto fmt_start = std::chrono::high_resolution_clock::now();
+      #ifdef DECODED_CACHE
+        // the logfile is only decoded, if the cache missed
+        if ( !resume )
+        {
+          cached = publish_from_cache(info, cache_key, plot_data, progress_dialog);
+        }
+        cache_progress = -1;
+        if ( cached != cache_result::MISSED )
+        {
+          finished = true;
+          return;
+        }
       #endif
 
-      // check if we don't reach the end
-      if ((uint32_t)(len - total_bytes_used) < sizeof(struct log_Format))
+      if ( resume )
       {
-        bytes_skipped += len - total_bytes_used;
-        break;
+        loaded = resume_logfile(buf, len, plot_data, report);
       }
-
-      // extract the message-id for which the FMT-message is defined and store FMT
-      const uint8_t msg_id = ((struct log_Format*)(&(buf[total_bytes_used])))->type;
-      has_fmt[msg_id] = true;
-      struct log_Format& fmt = formats[msg_id];
-      memcpy(&fmt, &buf[total_bytes_used], sizeof(struct log_Format));
-      for (char i : fmt.name)
+      else
       {
-        if (!isprint(i) && i != '\0')
-        {
-          // double check that this is a message
-          // name is assumed to be printable ascii; it
-          // looked like a format message, but wasn't.
-          total_bytes_used++;
-          bytes_skipped++;
-          continue;
-        }
+        loaded = is_compressed ? decode_logfile(compressed, plot_data, hooks, report)
+                               : decode_logfile(buf, len, plot_data, hooks, report);
       }
+    }
+    catch (...)
+    {
+      load_error = std::current_exception();
+      cancel_loads();
+    }
 
-      // store message name <-> message id mapping
-      uint8_t name_length = 0;
-      for (char i : fmt.name)
+    // the load is finished, when all logfiles are loaded (the first failure is kept)
+    for (auto& load : additional_loads)
+    {
+      load->worker.join();
+      if ( load->error && !load_error )
       {
-        if (i != '\0')
-        {
-          name_length++;
-        }
+        load_error = load->error;
       }
-      std::string msg_name(fmt.name, name_length);
-      msg_id2name[msg_id] = msg_name; 
-      msg_name2id[msg_name] = msg_id;
+    }
 
-      // store field name (label) <-> field idx mapping
-      uint8_t label_length = 0;
-      for (char i : fmt.labels)
+    #ifdef DECODED_CACHE
+      // the cache only holds whole logfiles without decimation and without the prefix of a multi-file load
+      try
       {
-        if (i != '\0')
+        if ( loaded && !load_error && !decoder.get_selection().window.enabled &&
+             !decoder.get_selection().decimation.enabled && additional_loads.empty() )
         {
-          label_length++;
+          write_cache(info, cache_key);
         }
       }
-      std::string labels(fmt.labels, label_length);
-      std::vector<std::string> labels_vec{};
-
-      // split labels at delimiter ","
-      size_t pos = 0;
-      std::string label;
-      while ( (pos = labels.find(",")) != std::string::npos )
+      catch (...)
       {
-        label = labels.substr(0,pos);
-        labels_vec.push_back(label);
-        labels.erase(0, pos + 1);
+        load_error = std::current_exception();
       }
-      labels_vec.push_back(labels);
-
-      // go through labels
-      for (size_t idx = 0; idx < labels_vec.size(); idx++)
-      {
-        const std::string& label = labels_vec[idx];
-        field_name2idx[msg_name][label] = idx;
-
-        /*
-        This is not needed, since the detection based on the unit char '#' is sufficient
-        // handle instances
-        //  - check if labels contain "instance"
-        if (strcmp(label.c_str(), "Instance") == 0)
-        {
-          has_instance[msg_id] = true;
-          instance_idx[msg_id] = idx;
-          instance_offset[msg_id] = get_field_byte_offset(msg_id, idx);
-        }
-        */
-      }
-
-      total_bytes_used += sizeof(struct log_Format);
-      msgs_read++;
-
-      #ifdef DEBUG_RUNTIME
-        auto fmt_end = std::chrono::high_resolution_clock::now();
-        fmt_ms += (fmt_end - fmt_start);
-      #endif
-
-      continue;
-    }
+      cache_progress = -1;
+    #endif
+    finished = true;
+  });
+  wait_for_load(progress_dialog, finished);
+  worker.join();
 
-    // get the full log format from the message type
-    const struct log_Format& fmt = formats[type];
+  // a failed load leaves no decoded data behind, the failure is passed on to PlotJuggler
+  if ( load_error )
+  {
+    file.unmap(const_cast<uint8_t*>(buf));
+    resumable_filename.clear();
+    decoder.release_decoded_data();
+    additional_loads.clear();
+    std::rethrow_exception(load_error);
+  }
 
-    // checks:
-    //  - if length of message is zero, continue
-    if ( fmt.length == 0 )
-    {
-      total_bytes_used += 1;
-      bytes_skipped += 1;
-      continue;
-    }
-    //  - if we reached the end of the log, just end
-    if (len - total_bytes_used < fmt.length)
+  #ifdef DECODED_CACHE
+    switch ( cached )
     {
-      progress_dialog.setValue(100);
-      bytes_skipped += len - total_bytes_used;
-      break;
+      case cache_result::PUBLISHED:
+        file.unmap(const_cast<uint8_t*>(buf));
+        resumable_filename.clear();
+        decoder.release_decoded_data();
+        qDebug() << "Loading the cached logfile took" << timer.elapsed() << "milliseconds";
+        return true;
+      case cache_result::CANCELED:
+        file.unmap(const_cast<uint8_t*>(buf));
+        return false;
+      case cache_result::MISSED:
+        break;
     }
+  #endif
+  published_series.clear();
 
-
-    // -------------------- handle FMTU-message -------------------- //
-    if ( memcmp(fmt.name, "FMTU", 4) == 0 )
+  // the decoded columns of this load are only kept, if the next load of this logfile may resume it (only with
+  // INCREMENTAL_RELOAD), otherwise they are freed right away, the published series hold the logfile
+  resumable_filename.clear();
+  #ifdef INCREMENTAL_RELOAD
+    if ( loaded && additional_loads.empty() && decoder.is_resumable() )
     {
-      #ifdef DEBUG_RUNTIME
-        auto fmtu_start = std::chrono::high_resolution_clock::now();
-      #endif
-
-      // extract the message-id for which the FMTU-message is defined and store FMTU
-      const uint8_t msg_id = ((struct log_Format_Units*)(&(buf[total_bytes_used])))->format_type;
-      has_fmtu[msg_id] = true;
-      struct log_Format_Units& fmtu = format_units[msg_id];
-      memcpy(&fmtu, &buf[total_bytes_used], sizeof(struct log_Format_Units));
-
+      resumable_filename = info->filename;
+    }
+  #endif
+  if ( resumable_filename.isEmpty() )
+  {
+    decoder.release_decoded_data();
+  }
 
-      // handle instances
-      //  - check if units contain "#" (see also: logformat.h)
-      if ( !has_instance[msg_id] )
-      {
-        uint8_t units_length = 0;
-        for (char i : fmtu.units)
-        {
-          if (i != '\0')
-          {
-            units_length++;
-          }
-        }
-        std::string units(fmtu.units, units_length);
+  file.unmap(const_cast<uint8_t*>(buf));
+  file.close();
+  if ( !loaded )
+  {
+    additional_loads.clear();
+    return false;
+  }
 
-        size_t pos = units.find("#");
-        if ( pos != std::string::npos )
-        {
-          has_instance[msg_id] = true;
-          instance_idx[msg_id] = pos;
-          instance_offset[msg_id] = get_field_byte_offset(msg_id, pos);
-        }
-      } 
-        
-      total_bytes_used += fmt.length;
-      msgs_read++;
-
-      #ifdef DEBUG_RUNTIME
-        auto fmtu_end = std::chrono::high_resolution_clock::now();
-        fmtu_ms += (fmtu_end - fmtu_start);
-      #endif
+  qDebug() << "The loading operation took" << timer.elapsed() << "milliseconds";
+  if ( resume )
+  {
+    qDebug() << "Resumed the last load, decoded" << report.bytes << "appended bytes";
+  }
 
-      continue;
+  print_load_summary(report);
+  for (const auto& load : additional_loads)
+  {
+    if ( load->loaded )
+    {
+      std::printf("  %s:", load->filename.toLocal8Bit().constData());
+      print_load_summary(load->report);
     }
+  }
+  additional_loads.clear();
 
+  #ifdef LOADER_STATS
+    publish_loader_stats(report.profile, plot_data);
+  #endif
 
-    // -------------------- handle MULT-message -------------------- //
-    if ( memcmp(fmt.name, "MULT", 4) == 0 )
-    {
-      #ifdef DEBUG_RUNTIME
-        auto mult_start = std::chrono::high_resolution_clock::now();
-      #endif
-
-      uint32_t id_offset = get_field_byte_offset(type, "Id");
-      uint32_t mult_offset = get_field_byte_offset(type, "Mult");
+  return true;
+}
 
-      // todo: data type is hardcoded here, change that?!
-      const unsigned char multiplier_char = *reinterpret_cast<const uint8_t*>(buf + total_bytes_used + id_offset);
-      const double multiplier = *reinterpret_cast<const double*>(buf + total_bytes_used + mult_offset);
 
-      multipliers[multiplier_char] = multiplier;
-      
-      total_bytes_used += fmt.length;
-      msgs_read++;
 
-      #ifdef DEBUG_RUNTIME
-        auto mult_end = std::chrono::high_resolution_clock::now();
-        mult_ms += (mult_end - mult_start);
-      #endif
+void DataLoadAPBIN::publish_loader_stats(const APBinDecoder::load_profile& profile, PlotDataMapRef& plot_data)
+{
+  // the counters of each message type are single points at the start of the logfile
+  const std::string prefix = "/_loader_stats/";
+  for (const auto& message : profile.messages)
+  {
+    const std::string msg_prefix = prefix + message.name + "/";
+    plot_data.addNumeric(msg_prefix + "bytes")->second.pushBack(PlotData::Point(profile.start_time, message.bytes));
+    plot_data.addNumeric(msg_prefix + "messages")->second.pushBack(PlotData::Point(profile.start_time, message.messages));
+    plot_data.addNumeric(msg_prefix + "skipped")->second.pushBack(PlotData::Point(profile.start_time, message.skipped));
+    plot_data.addNumeric(msg_prefix + "outside_window")->second.pushBack(PlotData::Point(profile.start_time, message.outside_window));
+    plot_data.addNumeric(msg_prefix + "decode_ms")->second.pushBack(PlotData::Point(profile.start_time, message.decode_ms));
+  }
 
-      continue;
+  // the skipped regions are placed at the time of their offset, so they line up with the decoded series
+  if ( !profile.skipped_regions.empty() )
+  {
+    PlotData& length = plot_data.addNumeric(prefix + "_skipped/length")->second;
+    PlotData& offset = plot_data.addNumeric(prefix + "_skipped/offset")->second;
+    for (const auto& region : profile.skipped_regions)
+    {
+      length.pushBack(PlotData::Point(region.time, region.length));
+      offset.pushBack(PlotData::Point(region.time, region.offset));
     }
+  }
+}
 
 
-    // -------------------- handle UNIT-message -------------------- //
-    if ( memcmp(fmt.name, "UNIT", 4) == 0 )
-    {
-      #ifdef DEBUG_RUNTIME
-        auto unit_start = std::chrono::high_resolution_clock::now();
-      #endif
+void* DataLoadAPBIN::PlotDataSink::add_series(const std::string& msg_name, const std::string& series_name)
+{
+  std::lock_guard<std::mutex> lock(series_mutex);
 
-      uint32_t id_offset = get_field_byte_offset(type, "Id");
-      uint32_t label_offset = get_field_byte_offset(type, "Label");
+  // the series of a redefined message is added again (see APBinSink), it is listed once
+  const std::string name = prefix + series_name;
+  const bool listed = plot_data.numeric.find(name) != plot_data.numeric.end();
+  auto series = plot_data.addNumeric(name);
+  if ( !listed )
+  {
+    published_series.push_back({ msg_name, series->first, &series->second });
+  }
+  return &series->second;
+}
 
-      // todo: data type is hardcoded here, change that?!
-      const unsigned char unit_char = *reinterpret_cast<const uint8_t*>(buf + total_bytes_used + id_offset);
-      const char* unit = reinterpret_cast<const char*>(buf + total_bytes_used + label_offset);
 
-      units[unit_char] = std::string(unit);
 
-      total_bytes_used += fmt.length;
-      msgs_read++;
+void DataLoadAPBIN::PlotDataSink::append(void* series, const double& time, const double& value)
+{
+  static_cast<PlotData*>(series)->pushBack(PlotData::Point(time, value));
+}
 
-      #ifdef DEBUG_RUNTIME
-        auto unit_end = std::chrono::high_resolution_clock::now();
-        unit_ms += (unit_end - unit_start);
-      #endif
 
-      continue;
-    }
 
+void DataLoadAPBIN::PlotDataSink::append(void* series, const double* times, const double* values, const size_t& count)
+{
+  // the block of a field is appended in one loop without a call of the sink per sample
+  //  - PlotData keeps its points in a deque, which can neither be reserved nor take over a prebuilt buffer
+  PlotData& data = *static_cast<PlotData*>(series);
+  for (size_t i = 0; i < count; i++)
+  {
+    data.pushBack(PlotData::Point(times[i], values[i]));
+  }
+}
 
-    // -------------------- handle any other message -------------------- //
 
-    // discard some messages that should not be used:
-    //  - ISBD, ISBH, MSG, PARM,
 
-    if ( memcmp(fmt.name, "ISBD", 4) == 0 )
+void DataLoadAPBIN::wait_for_load(QProgressDialog& progress_dialog, const std::atomic<bool>& finished)
+{
+  QEventLoop loop;
+  QTimer poll_timer;
+  int progress = -1;
+  QObject::connect(&poll_timer, &QTimer::timeout, &loop, [&]()
+  {
+    if ( finished )
     {
-      total_bytes_used += fmt.length;
-      msgs_skipped++;
-      continue;
+      loop.quit();
+      return;
     }
-    if ( memcmp(fmt.name, "ISBH", 4) == 0 )
+
+    // the dialog resets itself at 100%, an unchanged progress is not set again
+    //  - the progress of a multi-file load is the mean progress of all logfiles
+    //  - while the decoded cache is read or written, its progress is shown instead
+    int progress_sum = decoder.get_progress();
+    for (const auto& load : additional_loads)
     {
-      total_bytes_used += fmt.length;
-      msgs_skipped++;
-      continue;
+      progress_sum += load->decoder.get_progress();
     }
-    if ( memcmp(fmt.name, "MSG", 3) == 0 )
+    int current_progress = progress_sum / static_cast<int>(1 + additional_loads.size());
+    #ifdef DECODED_CACHE
+      if ( cache_progress >= 0 )
+      {
+        current_progress = cache_progress;
+      }
+    #endif
+    if ( current_progress != progress )
     {
-      total_bytes_used += fmt.length;
-      msgs_skipped++;
-      continue;
+      progress = current_progress;
+      progress_dialog.setValue(progress);
     }
-    if ( memcmp(fmt.name, "PARM", 4) == 0 )
+    if ( progress_dialog.wasCanceled() )
     {
-      total_bytes_used += fmt.length;
-      msgs_skipped++;
-      continue;
+      cancel_loads();
+      #ifdef DECODED_CACHE
+        cache_canceled = true;
+      #endif
     }
-
-    #ifdef DEBUG_RUNTIME
-      auto other_start = std::chrono::high_resolution_clock::now();
-    #endif
-
-    handle_message_received(fmt, &buf[total_bytes_used]);
-
-    total_bytes_used += fmt.length;
-    msgs_read++; // todo: this is incorrect, if message is read incomplete
-    
-    #ifdef DEBUG_RUNTIME
-      auto other_end = std::chrono::high_resolution_clock::now();
-      other_ms += (other_end - other_start);
-    #endif
-  }
+  });
+  poll_timer.start(PROGRESS_POLL_MS);
+  loop.exec();
+}
 
 
-  // -------------------- process UNITs -------------------- //
-  #ifdef DEBUG_RUNTIME
-      auto process_units_start = std::chrono::high_resolution_clock::now();
-  #endif
-  // - convert '/<unit>' spelling because it's incompatible with PlotJuggler
-  //    - PlotJuggler uses '/' in names for data splitting into subtopics
-  const std::string superscript_minus = "⁻";
-  const std::array<std::string, 3> superscript_numbers = {"¹", "²", "³"};
 
-  for (auto& unit_it : units)
-  {
-    std::string& unit = unit_it.second;
-
-    std::map<std::string, uint8_t> counter;
+bool DataLoadAPBIN::decode_logfile(const uint8_t* buf, const uint64_t& len, PlotDataMapRef& plot_data,
+                                   APBinDecoder::load_hooks& hooks, APBinDecoder::load_report& report)
+{
+  // the worker threads of the parallel decoding follow the thread pool of Qt
+  decoder.set_thread_count(QThread::idealThreadCount());
 
-    size_t pos = 0;
-    while ( (pos = unit.find("/")) != std::string::npos )
-    {
-      std::string token = unit.substr(pos+1, 1);
+  published_series.clear();
+  PlotDataSink sink(plot_data, published_series, series_prefix, series_mutex);
+  return decoder.decode(buf, len, sink, hooks, report);
+}
 
-      // push to map
-      auto counter_it = counter.find(token);
-      if (counter_it == counter.end())
-      {
-        counter[token] = 0;
-      }
-      else
-      {
-        counter[token]++;
-      }
-      
-      // erase old '/<unit>' from string
-      unit.erase(pos, pos + 1);
-    }
 
-    // append new style to string
-    for (auto& counter_it : counter)
-    {
-      unit.append(" " + counter_it.first + superscript_minus + superscript_numbers[counter_it.second]);
-    }
-  }
-  #ifdef DEBUG_RUNTIME
-    auto process_units_end = std::chrono::high_resolution_clock::now();
-    process_units_ms += (process_units_end - process_units_start);
-  #endif
 
+bool DataLoadAPBIN::resume_logfile(const uint8_t* buf, const uint64_t& len, PlotDataMapRef& plot_data,
+                                   APBinDecoder::load_report& report)
+{
+  published_series.clear();
+  PlotDataSink sink(plot_data, published_series, series_prefix, series_mutex);
+  return decoder.resume(buf, len, sink, report);
+}
 
-  // -------------------- apply multipliers -------------------- //
-  #ifdef DEBUG_RUNTIME
-    auto apply_mult_start = std::chrono::high_resolution_clock::now();
-  #endif
-  apply_multipliers();
-  #ifdef DEBUG_RUNTIME
-    auto apply_mult_end = std::chrono::high_resolution_clock::now();
-    apply_mult_ms += (apply_mult_end - apply_mult_start);
-  #endif
 
 
-  // -------------------- apply timesync -------------------- //
-  #ifdef DEBUG_RUNTIME
-    auto apply_tsync_start = std::chrono::high_resolution_clock::now();
-  #endif
-  apply_timesync();
-  #ifdef DEBUG_RUNTIME
-    auto apply_tsync_end = std::chrono::high_resolution_clock::now();
-    apply_tsync_ms += (apply_tsync_end - apply_tsync_start);
-  #endif
+bool DataLoadAPBIN::decode_logfile(APBinSource& source, PlotDataMapRef& plot_data, APBinDecoder::load_hooks& hooks,
+                                   APBinDecoder::load_report& report)
+{
+  published_series.clear();
+  PlotDataSink sink(plot_data, published_series, series_prefix, series_mutex);
+  return decoder.decode(source, sink, hooks, report);
+}
 
 
 
-  #ifdef DEBUG_MESSAGES
-  std::printf("\n--------- DEBUG_MESSAGES ---------");
-  for (int idx=0; idx < 256; idx++)
+void DataLoadAPBIN::start_additional_loads(const QString& filename, const APBinDecoder::selection& selection,
+                                           PlotDataMapRef& plot_data)
+{
+  if ( additional_logfiles.empty() )
   {
-    if (has_fmt[idx])
-    {
-      const struct log_Format& fmt = formats[idx];
-      std::string msg_name = std::string(fmt.name, MAX_NAME_SIZE);
-      std::string msg_labels = std::string(fmt.labels, MAX_LABELS_SIZE);
-      std::string msg_format = std::string(fmt.format, MAX_FORMAT_SIZE);
-      std::printf("\n%s:\n", msg_name.c_str());
-      std::printf("  -id: \t\t%u\n", fmt.type);
-      std::printf("  -labels: \t%s\n", msg_labels.c_str());
-      std::printf("  -format: \t%s\n", msg_format.c_str());
-      if (has_fmtu[idx])
-      {
-        const struct log_Format_Units& fmtu = format_units[idx];
-        std::string msg_units = std::string(fmtu.units, MAX_UNITS_SIZE);
-        std::string msg_multipliers = std::string(fmtu.multipliers, MAX_MULTIPLIERS_SIZE);
-        std::printf("  -units: \t%s\n", msg_units.c_str());
-        std::printf("  -multipliers: %s\n", msg_multipliers.c_str());
-        if (has_instance[idx] == true)
-        {
-          std::printf("  -has instance at idx: %i\n", instance_idx[idx]);
-        }        
-      }
-    }
+    return;
   }
-  std::printf("-------------- END --------------\n\n");
-  #endif
 
-  #ifdef DEBUG_MULTIPLIERS
-  std::printf("\n------- DEBUG_MULTIPLIERS -------\n");
-  for(const auto& multi_it : multipliers)
+  // the prefix is the stem of the logfile, logfiles with the same stem are numbered
+  std::set<std::string> prefixes;
+  auto make_prefix = [&prefixes](const QString& logfile)
   {
-    std::cout << multi_it.first << ": " << multi_it.second << std::endl;
-  }
-  std::printf("-------------- END --------------\n\n");
-  #endif
+    const std::string stem = get_logfile_stem(logfile);
+    std::string prefix = "/" + stem;
+    for (int number = 2; !prefixes.insert(prefix).second; number++)
+    {
+      prefix = "/" + stem + "_" + std::to_string(number);
+    }
+    return prefix;
+  };
+  series_prefix = make_prefix(filename);
 
-  #ifdef DEBUG_UNITS
-  std::printf("\n---------- DEBUG_UNITS ----------\n");
-  for(const auto& unit_it : units)
+  // the hardware threads are shared by all logfiles (the opened logfile has already split itself into chunks)
+  const int thread_count = std::max(1, QThread::idealThreadCount() / static_cast<int>(1 + additional_logfiles.size()));
+  for (const QString& logfile : additional_logfiles)
   {
-    std::cout << unit_it.first << ": " << unit_it.second << std::endl;
+    std::unique_ptr<logfile_load> load(new logfile_load());
+    load->filename = logfile;
+    load->prefix = make_prefix(logfile);
+    load->decoder.set_selection(selection);
+    load->decoder.set_thread_count(thread_count);
+    additional_loads.push_back(std::move(load));
   }
-  std::printf("-------------- END --------------\n\n");
-  #endif
 
-
-
-  // -------------------- publish to plotjuggler -------------------- //
-  #ifdef DEBUG_RUNTIME
-    auto publish_start = std::chrono::high_resolution_clock::now();
-  #endif
-  // iterate through messages
-  for (const auto& msg_it : messages_map)
+  // the loads are only started, when additional_loads is complete (it is read by wait_for_load and cancel_loads)
+  //  - a failed load cancels all other loads, its failure is rethrown by readDataFromFile
+  for (auto& load : additional_loads)
   {
-    const std::string& msg_name = msg_it.first;
-
-    // get message id for message name
-    const uint8_t& msg_id = msg_name2id[msg_name];
-
-    // only publish messages to plotjuggler, which have the "TimeUS" field!
-    auto time_idx_it = field_name2idx[msg_name].find("TimeUS");
-    if (time_idx_it == field_name2idx[msg_name].end())
-    {
-      std::printf("Ignoring message '%s' because it has no 'TimeUS' field!\n", msg_name.c_str());
-      continue;
-    }
-    
-    // iterate through instances
-    const auto& instances_map = msg_it.second;
-    for (const auto& inst_it : instances_map)
+    logfile_load& started_load = *load;
+    load->worker = std::thread([this, &started_load, &plot_data]()
     {
-      const message_data& msg_data = inst_it.second;
-
-      // iterate through fields
-
-      // extract timestamps from message data
-      const uint8_t& time_idx = field_name2idx[msg_name]["TimeUS"];
-      const std::vector<double>& timestamps = msg_data[time_idx].second;
-
-      size_t idx = 0;
-      for (const auto& field : msg_data)
+      try
       {
-        if ( idx == time_idx || ( has_instance[msg_id] && (idx == instance_idx[msg_id]) ) )
-        {
-          idx++;
-          continue;
-        }
-
-        const std::string instance_name = "#" + std::to_string(inst_it.first);
-        const std::string& field_name = field.first;
-
-        std::string series_name;
-        
-        if ( !has_instance[msg_id] )
-        {
-          series_name = "/" + msg_name + "/" + field_name;
-        }
-        else
-        {
-          series_name = "/" + msg_name + "/" + instance_name + "/" + field_name;
-        }
-
-        #ifdef LABEL_WITH_UNIT
-          std::string unit_str = get_unit(msg_name, field_name);
-          if ( !unit_str.empty() )
-          {
-            series_name = series_name + "\t[" + unit_str + "]";
-          }
-        #endif
-                
-        auto series = plot_data.addNumeric(series_name);
-
-        for (size_t i = 0; i < field.second.size(); i++)
-        {
-          const double& msg_time = timestamps[i];
-          PlotData::Point point(msg_time, field.second[i]);
-          series->second.pushBack(point);
-        }
-        idx++;
+        load_additional_logfile(started_load, plot_data, series_mutex);
       }
-    }
+      catch (...)
+      {
+        started_load.error = std::current_exception();
+        cancel_loads();
+      }
+    });
   }
-  #ifdef DEBUG_RUNTIME
-    auto publish_end = std::chrono::high_resolution_clock::now();
-    publish_ms += (publish_end - publish_start);
-  #endif
-
-  #ifdef DEBUG_RUNTIME
-    std::chrono::duration<double, std::milli> total_ms = fmt_ms + fmtu_ms + mult_ms + unit_ms + other_ms + process_units_ms + apply_mult_ms + apply_tsync_ms + publish_ms;
-    std::printf("\n--------- DEBUG_RUNTIME ---------");
-    std::printf("\nFMT-Loading (ms): \t%.2f", fmt_ms.count());
-    std::printf("\nFMTU-Loading (ms): \t%.2f", fmtu_ms.count());
-    std::printf("\nMULT-Loading (ms): \t%.2f", mult_ms.count());
-    std::printf("\nUNIT-Loading (ms): \t%.2f", unit_ms.count());
-    std::printf("\nOTHER-Loading (ms): \t%.2f\n", other_ms.count());
-
-    std::printf("\nProcess-Units (ms):\t%.2f", process_units_ms.count());
-    std::printf("\nApply-Multipliers (ms):\t%.2f", apply_mult_ms.count());
-    std::printf("\nApply-Timesync (ms):\t%.2f", apply_tsync_ms.count());
-    std::printf("\nPublish (ms):\t\t%.2f", publish_ms.count());
-    std::printf("\n---------------------------------");
-    std::printf("\nTOTAL (ms):\t\t%.2f", total_ms.count());
-    std::printf("\n-------------- END --------------\n\n");
-  #endif
-  
-  file.close();
-
-  qDebug() << "The loading operation took" << timer.elapsed() << "milliseconds";
-
-  std::printf("\n  Read messages:\t%d", msgs_read);
-  std::printf("\n  Skipped messages:\t%d", msgs_skipped);
-  std::printf("\n  Skipped bytes:\t%d from %d bytes\n\n", bytes_skipped, len);
-
-  return true;
 }
 
 
 
-
-
-void DataLoadAPBIN::handle_message_received(const struct log_Format& fmt, const uint8_t* msg)
+void DataLoadAPBIN::cancel_loads(void)
 {
-  // message id
-  const uint8_t& msg_id = fmt.type;
-
-  // message name
-  const std::string& msg_name = msg_id2name[msg_id];
-  
-  // instances
-  int8_t instance = 0;
-  if ( has_instance[msg_id] )
+  decoder.cancel();
+  for (auto& load : additional_loads)
   {
-    instance = get_instance(fmt, msg);
+    load->decoder.cancel();
   }
+}
+
 
-  // check if message already exists in messages_map
-  auto message_it = messages_map.find(msg_name);
-  if (message_it == messages_map.end())
+
+void DataLoadAPBIN::load_additional_logfile(logfile_load& load, PlotDataMapRef& plot_data, std::mutex& series_mutex)
+{
+  QFile file(load.filename);
+  const uint8_t* buf = nullptr;
+  if ( file.open(QFile::ReadOnly) && file.size() > 0 )
   {
-    messages_map[msg_name];
+    buf = file.map(0, file.size());
   }
-  
-  // check if instance already exists in message_map[msg_name]
-  auto instance_it = messages_map[msg_name].find(instance);
-  if (instance_it == messages_map[msg_name].end())
+  if ( buf == nullptr )
   {
-    messages_map[msg_name][instance] = create_message_data(fmt);
+    std::fprintf(stderr, "WARNING: can not load logfile %s!\n", load.filename.toLocal8Bit().constData());
+    return;
   }
-  message_data& msg_data = messages_map[msg_name][instance];
-
-  uint32_t msg_offset = LOG_PACKET_HEADER_LEN;  // discard header
-
-  
-  /*
-    If you need to change this section, please also fix logformat.h (format_types)!
-    AP_Logger: Format Types (https://github.com/ArduPilot/ardupilot/tree/master/libraries/AP_Logger#format-types)
-      - file: libraries/AP_Logger/LogStructure.h (commit: b80cc9a)
-      - line: 9 - 28
-  */
-
-  // for each field, we get the data according to the format types
-  // this uses pointer arithmetic, so just close your eyes
-  double value{ 0 };
-  for (int i = 0; i < msg_data.size(); i++)
+  const uint64_t len = static_cast<uint64_t>(file.size());
+
+  // the messages are taken from the selection of the opened logfile, no dialog is shown
+  APBinDecoder::load_hooks hooks;
+  PlotDataSink sink(plot_data, load.published_series, load.prefix, series_mutex);
+  if ( CompressedLogfile::detect(buf, len) != CompressedLogfile::compression::NONE )
   {
-    const char typeCode = fmt.format[i];
-    switch (typeCode)
+    CompressedLogfile compressed;
+    if ( compressed.open(buf, len) )
     {
-      case 'a':
-        // not used, that is for ISBD
-        msg_offset += sizeof(int16_t[32]);
-        break;
-      case 'b':
-        value = static_cast<double>(*reinterpret_cast<const int8_t*>(msg + msg_offset));
-        msg_offset += sizeof(int8_t);
-        break;
-      case 'B':
-        value = static_cast<double>(*reinterpret_cast<const uint8_t*>(msg + msg_offset));
-        msg_offset += sizeof(uint8_t);
-        break;
-      case 'h':
-        value = static_cast<double>(*reinterpret_cast<const int16_t*>(msg + msg_offset));
-        msg_offset += sizeof(int16_t);
-        break;
-      case 'H':
-        value = static_cast<double>(*reinterpret_cast<const uint16_t*>(msg + msg_offset));
-        msg_offset += sizeof(uint16_t);
-        break;
-      case 'i':
-        value = static_cast<double>(*reinterpret_cast<const int32_t*>(msg + msg_offset));
-        msg_offset += sizeof(int32_t);
-        break;
-      case 'I':
-        value = static_cast<double>(*reinterpret_cast<const uint32_t*>(msg + msg_offset));
-        msg_offset += sizeof(uint32_t);
-        break;
-      case 'f':
-        value = static_cast<double>(*reinterpret_cast<const float*>(msg + msg_offset));
-        msg_offset += sizeof(float);
-        break;
-      case 'd':
-        value = static_cast<double>(*reinterpret_cast<const double*>(msg + msg_offset));
-        msg_offset += sizeof(double);
-        break;
-      case 'n':
-        // not used, that is for MSG or PARAM
-        msg_offset += sizeof(char[4]);
-        break;
-      case 'N':
-        // not used, that is for MSG or PARAM
-        msg_offset += sizeof(char[16]);
-        break;
-      case 'Z':
-        // not used, that is for MSG or PARAM
-        msg_offset += sizeof(char[64]);
-        break;
-      case 'c':
-        value = static_cast<double>(*reinterpret_cast<const int16_t*>(msg + msg_offset));
-        msg_offset += sizeof(int16_t);
-        break;
-      case 'C':
-        value = static_cast<double>(*reinterpret_cast<const uint16_t*>(msg + msg_offset));
-        msg_offset += sizeof(uint16_t);
-        break;
-      case 'e':
-        value = static_cast<double>(*reinterpret_cast<const int32_t*>(msg + msg_offset));
-        msg_offset += sizeof(int32_t);
-        break;
-      case 'E':
-        value = static_cast<double>(*reinterpret_cast<const uint32_t*>(msg + msg_offset));
-        msg_offset += sizeof(uint32_t);
-        break;
-      case 'L':
-        value = static_cast<double>(*reinterpret_cast<const int32_t*>(msg + msg_offset));
-        msg_offset += sizeof(int32_t);
-        break;
-      case 'M':
-        value = static_cast<double>(*reinterpret_cast<const uint8_t*>(msg + msg_offset));
-        msg_offset += sizeof(uint8_t);
-        break;
-      case 'q':
-        value = static_cast<double>(*reinterpret_cast<const int64_t*>(msg + msg_offset));
-        msg_offset += sizeof(int64_t);
-        break;
-      case 'Q':
-        value = static_cast<double>(*reinterpret_cast<const uint64_t*>(msg + msg_offset));
-        msg_offset += sizeof(uint64_t);
-        break;
-      default:
-        std::fprintf(stderr, "ERROR: format type '%c' is not defined!\n", typeCode); 
-        // At this point the field offset is unknown, therefore we can not proceed to interpret the remaining fields!
-        return;
+      load.loaded = load.decoder.decode(compressed, sink, hooks, load.report);
     }
-
-    msg_data[i].second.push_back(value);
-
+    else
+    {
+      std::fprintf(stderr, "WARNING: can not decompress logfile %s: %s\n", load.filename.toLocal8Bit().constData(),
+                   compressed.get_error().c_str());
+    }
+  }
+  else
+  {
+    load.loaded = load.decoder.decode(buf, len, sink, hooks, load.report);
   }
+  file.unmap(const_cast<uint8_t*>(buf));
 }
 
 
 
-DataLoadAPBIN::message_data DataLoadAPBIN::create_message_data(const struct log_Format& fmt)
+bool DataLoadAPBIN::xmlSaveState(QDomDocument& doc, QDomElement& parent_element) const
 {
-  QString labelStr(fmt.labels);
-  labelStr.truncate(MAX_LABELS_SIZE);
-  QStringList labels_list;
-  if (labelStr.size() > 0)
+  const APBinDecoder::selection& selection = decoder.get_selection();
+
+  QDomElement selection_elem = doc.createElement("selected_messages");
+  for (const std::string& msg_name : selection.messages)
   {
-    labels_list = labelStr.split(",");
+    QDomElement msg_elem = doc.createElement("message");
+    msg_elem.setAttribute("name", QString::fromStdString(msg_name));
+    selection_elem.appendChild(msg_elem);
   }
+  parent_element.appendChild(selection_elem);
+
+  QDomElement window_elem = doc.createElement("time_window");
+  window_elem.setAttribute("enabled", selection.window.enabled ? "true" : "false");
+  window_elem.setAttribute("utc", selection.window.utc ? "true" : "false");
+  window_elem.setAttribute("start", QString::number(selection.window.start, 'g', 17));
+  window_elem.setAttribute("end", QString::number(selection.window.end, 'g', 17));
+  parent_element.appendChild(window_elem);
+
+  QDomElement decimation_elem = doc.createElement("decimation");
+  decimation_elem.setAttribute("enabled", selection.decimation.enabled ? "true" : "false");
+  decimation_elem.setAttribute("max_rate", QString::number(selection.decimation.max_rate, 'g', 17));
+  for (const auto& rule : selection.decimation.rules)
+  {
+    QDomElement rule_elem = doc.createElement("rule");
+    rule_elem.setAttribute("pattern", QString::fromStdString(rule.pattern));
+    rule_elem.setAttribute("max_rate", QString::number(rule.max_rate, 'g', 17));
+    rule_elem.setAttribute("max_points", QString::number(static_cast<qulonglong>(rule.max_points)));
+    decimation_elem.appendChild(rule_elem);
+  }
+  parent_element.appendChild(decimation_elem);
 
-  message_data msg_data;
-  msg_data.reserve(labels_list.size());
-  for (auto i = 0; i < labels_list.size(); i++)
+  QDomElement logfiles_elem = doc.createElement("additional_logfiles");
+  for (const QString& logfile : additional_logfiles)
   {
-    msg_data.emplace_back(labels_list.at(i).toLocal8Bit().constData(), std::vector<double>());
+    QDomElement logfile_elem = doc.createElement("logfile");
+    logfile_elem.setAttribute("filename", logfile);
+    logfiles_elem.appendChild(logfile_elem);
   }
-  return msg_data;
+  parent_element.appendChild(logfiles_elem);
+  return true;
 }
 
 
 
-uint32_t DataLoadAPBIN::get_field_byte_offset(const uint8_t& msg_id, const uint8_t& field_idx)
+bool DataLoadAPBIN::xmlLoadState(const QDomElement& parent_element)
 {
-  // check if FMT exists
-  if ( !has_fmt[msg_id])
+  const QDomElement selection_elem = parent_element.firstChildElement("selected_messages");
+  if ( selection_elem.isNull() )
   {
-    // raise error, because fmt does not exist!
-    std::fprintf(stderr, "ERROR: FMT for message %u does not exist!\n", msg_id);
-    exit(EXIT_FAILURE);
+    return false;
   }
 
-  // get information from FMT
-  const struct log_Format& fmt = formats[msg_id];
-  const char* format = fmt.format;
-
-  // calculate offsets:
+  APBinDecoder::selection selection;
+  selection.messages.clear();
+  for (QDomElement msg_elem = selection_elem.firstChildElement("message"); !msg_elem.isNull();
+       msg_elem = msg_elem.nextSiblingElement("message"))
+  {
+    selection.messages.push_back(msg_elem.attribute("name").toStdString());
+  }
 
-  // - header offset
-  uint32_t header_offset = LOG_PACKET_HEADER_LEN;
+  // the time window is optional (layouts of older versions)
+  const QDomElement window_elem = parent_element.firstChildElement("time_window");
+  if ( !window_elem.isNull() )
+  {
+    selection.window.enabled = (window_elem.attribute("enabled") == "true");
+    selection.window.utc = (window_elem.attribute("utc") == "true");
+    selection.window.start = window_elem.attribute("start").toDouble();
+    selection.window.end = window_elem.attribute("end").toDouble();
+  }
 
-  // - data offset
-  uint32_t data_offset = 0;
-  for (uint8_t idx = 0; idx < field_idx; idx++)
+  const QDomElement decimation_elem = parent_element.firstChildElement("decimation");
+  if ( !decimation_elem.isNull() )
   {
-    const auto format_types_it = format_types.find(format[idx]);
-    if ( format_types_it == format_types.end() )
+    selection.decimation.enabled = (decimation_elem.attribute("enabled") == "true");
+    selection.decimation.max_rate = decimation_elem.attribute("max_rate").toDouble();
+    for (QDomElement rule_elem = decimation_elem.firstChildElement("rule"); !rule_elem.isNull();
+         rule_elem = rule_elem.nextSiblingElement("rule"))
     {
-      // raise error, because format type definition is missing
-      std::fprintf(stderr, "ERROR: format type '%c' is not defined!\n", format[idx]);
-      exit(EXIT_FAILURE);
+      APBinDecoder::decimation_rule rule;
+      rule.pattern = rule_elem.attribute("pattern").toStdString();
+      rule.max_rate = rule_elem.attribute("max_rate").toDouble();
+      rule.max_points = rule_elem.attribute("max_points").toULongLong();
+      selection.decimation.rules.push_back(rule);
     }
-    data_offset += format_types_it->second;
   }
 
-  uint32_t total_offset = header_offset + data_offset;
+  // further logfiles of a multi-file load
+  additional_logfiles.clear();
+  const QDomElement logfiles_elem = parent_element.firstChildElement("additional_logfiles");
+  for (QDomElement logfile_elem = logfiles_elem.firstChildElement("logfile"); !logfile_elem.isNull();
+       logfile_elem = logfile_elem.nextSiblingElement("logfile"))
+  {
+    additional_logfiles.append(logfile_elem.attribute("filename"));
+  }
 
-  return total_offset;
+  decoder.set_selection(selection);
+  return true;
 }
 
 
 
-uint32_t DataLoadAPBIN::get_field_byte_offset(const uint8_t& msg_id, const std::string& field_name)
+bool DataLoadAPBIN::resolve_selection(PJ::FileLoadInfo* info, const std::vector<APBinDecoder::message_info>& messages,
+                                      const APBinDecoder::time_range& range, APBinDecoder::selection& selection,
+                                      QProgressDialog& progress_dialog)
 {
-  const std::string& msg_name = msg_id2name[msg_id];
-  const uint8_t field_idx = field_name2idx[msg_name][field_name];
-
-  return get_field_byte_offset(msg_id, field_idx);
-}
-
-
+  // selection of a previous load (layout or reload)
+  additional_logfiles.clear();
+  if ( info->plugin_config.hasChildNodes() && xmlLoadState(info->plugin_config.firstChildElement()) )
+  {
+    selection = decoder.get_selection();
+  }
 
-uint8_t DataLoadAPBIN::get_instance(const struct log_Format& fmt, const uint8_t* msg)
-{
-  // Read sensor instance from raw message byte sequence
+  if ( !info->selected_datasources.empty() )
+  {
+    selection.messages = to_std_vector(info->selected_datasources);
+  }
+  else
+  {
+    // without a previous selection all messages are checked
+    const QStringList initial_selection = selection.messages.empty() ? QStringList{ "*" } : to_string_list(selection.messages);
 
-  // get message id from FMT
-  const uint8_t& msg_id = fmt.type;
-  
-  // get instance byte offset
-  const uint32_t& inst_offset = instance_offset[msg_id];
+    progress_dialog.hide();
+    DialogSelectMessages dialog(messages, initial_selection, range, selection.window, selection.decimation,
+                                additional_logfiles);
+    if ( dialog.exec() != QDialog::Accepted )
+    {
+      return false;
+    }
+    selection.messages = to_std_vector(dialog.get_selection());
+    selection.window = dialog.get_time_window();
+    selection.decimation = dialog.get_decimation();
+    additional_logfiles = dialog.get_logfiles();
+    additional_logfiles.removeAll(info->filename);
+    progress_dialog.show();
+  }
 
-  // get instance
-  uint8_t instance{ 0 };
-  memcpy(&instance, &msg[inst_offset], sizeof(uint8_t));
+  // remember the selection for the next load
+  decoder.set_selection(selection);
+  info->selected_datasources = to_string_list(selection.messages);
+  info->plugin_config = QDomDocument();
+  QDomElement plugin_elem = info->plugin_config.createElement("plugin");
+  plugin_elem.setAttribute("ID", name());
+  xmlSaveState(info->plugin_config, plugin_elem);
+  info->plugin_config.appendChild(plugin_elem);
 
-  return instance;
+  return true;
 }
 
 
 
-std::string DataLoadAPBIN::get_unit(const std::string& msg_name, const std::string& field_name)
+DataLoadAPBIN::cache_result DataLoadAPBIN::publish_from_cache(PJ::FileLoadInfo* info, const DecodedCache::cache_key& key,
+                                                              PlotDataMapRef& plot_data, QProgressDialog& progress_dialog)
 {
-  // get message id for message name
-  const uint8_t& msg_id = msg_name2id[msg_name];
-
-  // check if FMTU exists
-  if ( !has_fmtu[msg_id] )
+  DecodedCache cache;
+  if ( !cache.open(info->filename, key) )
   {
-    std::fprintf(stderr, "\nWARNING: no FMTU for message %s found! Can not apply units!\n", msg_name.c_str());
-    return "";
+    return cache_result::MISSED;
   }
 
-  // get data index of field
-  const uint8_t& idx = field_name2idx[msg_name][field_name];
-
-  // get unit descriptor char
-  const char& unit_char = format_units[msg_id].units[idx];
-
-  // get unit string 
-  const auto& unit_it = units.find(unit_char);
-  if ( unit_it == units.end() )
+  // the messages are selected with the metadata of the cache instead of a pre-scan
+  std::vector<APBinDecoder::message_info> messages;
+  for (const auto& message : cache.get_messages())
   {
-    std::fprintf(stderr, "WARNING: No unit for unit-id %c found! Can not apply unit in message: %s\n", unit_char, msg_name.c_str());
-    return "";
+    messages.push_back({ message.name, static_cast<int>(message.instances), message.samples });
   }
-
-  return unit_it->second;
-}
-
-
-
-void DataLoadAPBIN::apply_multipliers(void)
-{
-  // Go through all messages, instances, fields and apply the correct multiplier from FMTU and MULT
-
-  // iterate through messages
-  for (auto& msg_it : messages_map)
+  const DecodedCache::time_range& cached_range = cache.get_time_range();
+  const APBinDecoder::time_range range{ cached_range.first, cached_range.last, cached_range.has_utc, cached_range.utc_offset };
+  APBinDecoder::selection selection = decoder.get_selection();
+  bool selected = false;
+  QMetaObject::invokeMethod(&progress_dialog, [&]()
+  {
+    selected = resolve_selection(info, messages, range, selection, progress_dialog);
+  }, Qt::BlockingQueuedConnection);
+  if ( !selected )
   {
-    const std::string& msg_name = msg_it.first;
+    return cache_result::CANCELED;
+  }
 
-    // get message id for message name
-    const uint8_t& msg_id = msg_name2id[msg_name];
+  // the cache holds the whole logfile without decimation and without the prefix of a multi-file load
+  if ( selection.window.enabled || selection.decimation.enabled )
+  {
+    std::printf("Time window or decimation selected, decoding logfile\n");
+    return cache_result::MISSED;
+  }
+  if ( !additional_logfiles.empty() )
+  {
+    std::printf("Further logfiles selected, decoding logfiles\n");
+    return cache_result::MISSED;
+  }
 
-    // check if FMTU exists
-    if ( !has_fmtu[msg_id] )
+  // the cache can only be used, if it contains all selected messages
+  std::set<std::string> selected_messages;
+  for (const auto& message : cache.get_messages())
+  {
+    if ( !APBinDecoder::matches(selection.messages, message.name) )
     {
-      std::fprintf(stderr, "WARNING: No FMTU for message %s found. Can not apply multipliers!\n", msg_name.c_str());
       continue;
     }
-
-    // iterate through instances
-    auto& instances_map = msg_it.second;
-    for (auto& inst_it : instances_map)
+    if ( !message.decoded )
     {
-      message_data& msg_data = inst_it.second;
-
-      // iterate through fields
-      for (int idx = 0; idx < msg_data.size(); idx++)
-      {
-        // get multiplier descriptor char
-        const char& field_multiplier_char = format_units[msg_id].multipliers[idx];
+      std::printf("Cache does not contain message '%s', decoding logfile\n", message.name.c_str());
+      return cache_result::MISSED;
+    }
+    selected_messages.insert(message.name);
+  }
 
-        // get multiplier double
-        const auto multiplier_it = multipliers.find(field_multiplier_char);
-        if ( multiplier_it == multipliers.end() )
-        {
-          std::fprintf(stderr, "WARNING: No multiplier for multiplier-id %c found! Can not apply multiplier in message: %s\n", field_multiplier_char, msg_name.c_str());
-          continue;
-        }
-        const double field_multiplier = multiplier_it->second;
+  const std::vector<DecodedCache::series_entry>& series = cache.get_series();
+  cache_progress = 0;
+  for (size_t idx = 0; idx < series.size(); idx++)
+  {
+    const DecodedCache::series_entry& entry = series[idx];
+    if ( selected_messages.count(entry.msg_name) == 0 )
+    {
+      continue;
+    }
 
-        // check if multiplier is 0 or 1
-        if ( is_nearly(field_multiplier, 0) || is_nearly(field_multiplier, 1) )
-        {
-          continue;
-        }
+    auto plot_series = plot_data.addNumeric(entry.name);
+    for (uint64_t i = 0; i < entry.samples; i++)
+    {
+      plot_series->second.pushBack(PlotData::Point(entry.x[i], entry.y[i]));
+    }
 
-        std::vector<double>& field_data = msg_data[idx].second;
-        std::transform(field_data.begin(), field_data.end(), field_data.begin(), std::bind(std::multiplies<double>(), std::placeholders::_1, field_multiplier));
-      }
+    // report the progress and check for a cancel (polled by the GUI thread, see wait_for_load)
+    cache_progress = static_cast<int>(100 * (idx + 1) / series.size());
+    if ( cache_canceled )
+    {
+      return cache_result::CANCELED;
     }
   }
+
+  return cache_result::PUBLISHED;
 }
 
 
 
-void DataLoadAPBIN::apply_timesync(void)
+void DataLoadAPBIN::write_cache(const PJ::FileLoadInfo* info, const DecodedCache::cache_key& key)
 {
-  // ArduPilot logs should be comparable with rosbags, therefore the same time basis is needed...
-  //  - rosbag:         unix time
-  //  - ArduPilot log:  local time since power on
-  //    -> the logged GNSS time can be used for synchronisation
-
-  // extract GNSS time
-  const auto msg_it = messages_map.find("GPS");
-  if ( msg_it == messages_map.end() )
+  // all messages of the logfile are listed, the unselected ones are marked as not decoded
+  std::vector<DecodedCache::message_entry> messages;
+  for (const auto& message : decoder.get_messages())
   {
-    std::printf("Skipping timesync because the logfile does not contain GNSS data\n");
-    return;
+    messages.push_back({ message.name, static_cast<uint32_t>(message.instances), message.samples,
+                         APBinDecoder::matches(decoder.get_selection().messages, message.name) });
   }
 
-  // take the first instance as reference
-  // todo: change that?
-  const message_data& gps_msg_data = messages_map["GPS"][0];
-
-  // counter
-  int idx;
-  
-  // get needed field indexes
-  const auto& gps_time_idx = field_name2idx["GPS"]["TimeUS"];
-  const auto& gps_week_idx = field_name2idx["GPS"]["GWk"]; // GWk -> GPS week
-  const auto& gps_ms_idx = field_name2idx["GPS"]["GMS"];   // GMS -> GPS seconds in week (ms)
-
-  // constant time offset variables
-  static constexpr double GPS2UNIX_TIME_OFFSET = 315964800;   // time offset between unix and gps time
-  static constexpr double GPS2UNIX_LEAP_SECONDS = -18;        // additional time offset due to leap seconds (must be adjusted if number of leap seconds changes!)
-  static constexpr double SECONDS_PER_WEEK = 604800;          // number of seconds per week
-
-  const double& gps_week = gps_msg_data[gps_week_idx].second[1];
-  const double gps_week_seconds = gps_msg_data[gps_ms_idx].second[1] * 0.001;
-
-  const double unix_time = gps_week * SECONDS_PER_WEEK + gps_week_seconds + GPS2UNIX_TIME_OFFSET + GPS2UNIX_LEAP_SECONDS;
-
-  const double& log_time = gps_msg_data[gps_time_idx].second[1];
-
-  const double time_offset = unix_time - log_time;
-
-
-  // iterate through messages
-  for (auto& msg_it : messages_map)
+  const APBinDecoder::time_range& logfile_range = decoder.get_time_range();
+  const DecodedCache::time_range range{ logfile_range.first, logfile_range.last, logfile_range.has_utc,
+                                        logfile_range.utc_offset };
+  cache_progress = 0;
+  auto report_progress = [this](const int& progress)
   {
-    const auto& msg_name = msg_it.first;
-
-    auto time_idx_it = field_name2idx[msg_name].find("TimeUS");
-    if (time_idx_it == field_name2idx[msg_name].end())
-    {
-      continue;
-    }
-    auto& time_idx = time_idx_it->second;
-
-    // iterate through instances
-    auto& instances_map = msg_it.second;
-    for (auto& inst_it : instances_map)
-    {
-      // add time offset
-      message_data& msg_data = inst_it.second;
-
-      std::vector<double>& timestamps = msg_data[time_idx].second;
-      std::transform(timestamps.begin(), timestamps.end(), timestamps.begin(), std::bind(std::plus<double>(), std::placeholders::_1, time_offset));
-    }
+    cache_progress = progress;
+    return !cache_canceled;
+  };
+  if ( DecodedCache::write(info->filename, key, messages, published_series, range, report_progress) )
+  {
+    std::printf("Decoded logfile is cached for the next load\n");
+  }
+  else if ( cache_canceled )
+  {
+    std::printf("Writing the cache was canceled, the logfile is decoded again by the next load\n");
   }
-}
\ No newline at end of file
+}
+
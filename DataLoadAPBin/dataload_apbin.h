@@ -15,11 +15,22 @@
 
 #include <QObject>
 #include <QtPlugin>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include "PlotJuggler/dataloader_base.h"
-#include "logformat.h"
+#include "apbin_decoder.h"
+#include "decoded_cache.h"
+#include "dialog_select_messages.h"
 
 using namespace PJ;
 
+class QProgressDialog;
+
 class DataLoadAPBIN : public DataLoader
 {
   Q_OBJECT
@@ -39,72 +50,154 @@ public:
     return "ArduPilot Bin";
   }
 
-protected:
-
-private:
-  std::vector<const char*> extensions;
-
-
-  // message_data holds the data of a message for each timestamp
-  //  - std::string:  field name (label)
-  //  - std::vector:  field data (fields)
-  typedef std::vector<std::pair<std::string, std::vector<double>>> message_data;
-
-  // messages_map is a nested map which contains all messages
-  //  - key1:   message name
-  //  - key2:   instance number
-  //  - value:  message_data
-  std::map<std::string, std::map<int8_t, message_data>> messages_map;
-
-
-  // multipliers and units from MULT and UNIT messages
-  std::map<char, double> multipliers;
-  std::map<char, std::string> units;
-
+  // the message selection is stored in the layout, so that reloading a logfile doesn't ask for it again
+  bool xmlSaveState(QDomDocument& doc, QDomElement& parent_element) const override;
+  bool xmlLoadState(const QDomElement& parent_element) override;
 
-  // format (FMT) and format unit (FMTU) handling variables
-  static constexpr uint16_t MAX_FORMATS = 256;
-  struct log_Format formats[MAX_FORMATS] = {};            // FMT
-  struct log_Format_Units format_units[MAX_FORMATS] = {}; // FMTU
 
-  bool has_fmt[MAX_FORMATS] = {false};    // indicator, if FMT for a given message id exists
-  bool has_fmtu[MAX_FORMATS] = {false};   // indicator, if FMTU for a given message id exists
+  // decode a mapped logfile into plot_data without any dialog (e.g. benchmarks), may be called from any thread
+  //  - returns false, if loading was canceled
+  bool decode_logfile(const uint8_t* buf, const uint64_t& len, PlotDataMapRef& plot_data,
+                      APBinDecoder::load_hooks& hooks, APBinDecoder::load_report& report);
 
+  // decode a streamed logfile (e.g. a compressed logfile, see compressed_logfile.h) into plot_data without any dialog,
+  // may be called from any thread
+  //  - returns false, if loading was canceled
+  bool decode_logfile(APBinSource& source, PlotDataMapRef& plot_data, APBinDecoder::load_hooks& hooks,
+                      APBinDecoder::load_report& report);
 
-  // instance handling variables
-  bool has_instance[MAX_FORMATS] = {false};     // indicator, if a message contains intances
-  int instance_idx[MAX_FORMATS] = {-1};         // index of field, which contains the instance number
-  uint32_t instance_offset[MAX_FORMATS] = {0};  // byte-offset of field, which containts the instance number
-
-
-  // message name <-> message id mapping
-  std::string msg_id2name[MAX_FORMATS] = {};
-  std::map<std::string, uint8_t> msg_name2id;
+  // decode only the bytes of a mapped logfile, which were appended since its last load, into plot_data without any dialog
+  //  - all series of the logfile are published again (see APBinDecoder::resume)
+  //  - returns false, if loading was canceled
+  bool resume_logfile(const uint8_t* buf, const uint64_t& len, PlotDataMapRef& plot_data,
+                      APBinDecoder::load_report& report);
 
+  // set the messages (names or wildcard patterns), the time window and the decimation of the next load
+  void set_selection(const APBinDecoder::selection& selection)
+  {
+    decoder.set_selection(selection);
+  }
 
-  // field name <-> field idx mapping
-  std::map<std::string, std::map<std::string, uint8_t>> field_name2idx;
+protected:
 
+private:
+  std::vector<const char*> extensions;
 
-  // fill the message_data for a message according to the message format
-  void handle_message_received(const struct log_Format& fmt, const uint8_t* msg);
 
-  // create message_data for a message
-  message_data create_message_data(const struct log_Format& fmt);
+  // decoder of the logfiles (see apbin_decoder.h), the plugin only adds the dialogs, the layout state and the cache
+  APBinDecoder decoder;
 
-  // get the byte offset of a field in a message
-  uint32_t get_field_byte_offset(const uint8_t& msg_id, const uint8_t& field_idx);
-  uint32_t get_field_byte_offset(const uint8_t& msg_id, const std::string& field_name);
 
-  // get the instance number from a message
-  uint8_t get_instance(const struct log_Format& fmt, const uint8_t* msg);
+  // background loading handling variables
+  //  - the logfile is decoded on a worker thread, the GUI thread keeps running its event loop
+  //  - the progress dialog is updated from the progress of the decoder in this interval
+  static constexpr int PROGRESS_POLL_MS = 50;
 
-  // get unit string for a field
-  std::string get_unit(const std::string& msg_name, const std::string& field_name);
+  // run the event loop of the GUI thread until the worker has finished the load
+  //  - shows the progress of the decoder (or of the decoded cache) and cancels the load, if the progress dialog
+  //    was canceled
+  void wait_for_load(QProgressDialog& progress_dialog, const std::atomic<bool>& finished);
 
-  // apply multipliers from FMTU and MULT messages to the messages_map
-  void apply_multipliers(void);
 
-  // apply time synchronization to the messages_map
-  void apply_timesync(void);
+  // multi-file loading handling variables
+  //  - further logfiles selected in the dialog are loaded together with the opened logfile (e.g. to compare flights),
+  //    each one by its own decoder on its own worker thread, so the load takes about as long as the largest logfile
+  //  - the series of all logfiles are placed under /<logfile stem>/, the series of a single logfile stay unprefixed
+  //  - all sinks share the plot_data, only the creation of a series is serialized (each series has a single writer)
+  struct logfile_load
+  {
+    QString filename;
+    std::string prefix;
+    APBinDecoder decoder;
+    APBinDecoder::load_report report;
+    std::vector<DecodedCache::series_source> published_series;
+    bool loaded = false;
+    std::exception_ptr error;   // failure of the load (e.g. std::bad_alloc), it cancels all other loads
+    std::thread worker;
+  };
+  QStringList additional_logfiles;                              // logfiles loaded together with the opened logfile
+  std::vector<std::unique_ptr<logfile_load>> additional_loads;  // loads of the additional_logfiles
+  std::string series_prefix;                                    // prefix of the series of the opened logfile
+  std::mutex series_mutex;
+
+  // start the loads of the additional_logfiles with the selection of the opened logfile
+  void start_additional_loads(const QString& filename, const APBinDecoder::selection& selection,
+                              PlotDataMapRef& plot_data);
+
+  // load a logfile of additional_loads into plot_data (runs on the worker thread of the load)
+  static void load_additional_logfile(logfile_load& load, PlotDataMapRef& plot_data, std::mutex& series_mutex);
+
+  // cancel the load of the opened logfile and of all additional_loads (may be called from any thread)
+  void cancel_loads(void);
+
+
+  // incremental reload handling variables (only with INCREMENTAL_RELOAD)
+  //  - the decoder keeps the decoded columns of the last load, a reload of the same logfile resumes it
+  //  - the kept columns cost about the size of the decoded logfile in memory for the rest of the session, they are
+  //    freed after every load, which can not be resumed
+  QString resumable_filename;   // logfile of the last load (empty, if the last load can not be resumed)
+
+
+  // publish the load profile as /_loader_stats/<message>/{bytes,messages,skipped,decode_ms} and
+  // /_loader_stats/_skipped/{length,offset} series (only with LOADER_STATS)
+  void publish_loader_stats(const APBinDecoder::load_profile& profile, PlotDataMapRef& plot_data);
+
+
+  // sink of the decoder, which appends the decoded samples to the plotjuggler series
+  //  - all created series are recorded for the decoded cache
+  //  - the series names get the prefix of the logfile (see multi-file loading), which is set before the first series
+  //    is created
+  class PlotDataSink : public APBinSink
+  {
+  public:
+    PlotDataSink(PlotDataMapRef& plot_data, std::vector<DecodedCache::series_source>& published_series,
+                 const std::string& prefix, std::mutex& series_mutex)
+      : plot_data(plot_data), published_series(published_series), prefix(prefix), series_mutex(series_mutex)
+    {
+    }
+
+    void* add_series(const std::string& msg_name, const std::string& series_name) override;
+    void append(void* series, const double& time, const double& value) override;
+    void append(void* series, const double* times, const double* values, const size_t& count) override;
+
+  private:
+    PlotDataMapRef& plot_data;
+    std::vector<DecodedCache::series_source>& published_series;
+    const std::string& prefix;
+    std::mutex& series_mutex;
+  };
+
+
+  // decoded cache handling variables (only with DECODED_CACHE, see decoded_cache.h)
+  //  - the published series are written to the cache after loading
+  //  - a valid cache is published instead of decoding the logfile, if it contains all selected messages
+  //  - the cache is read and written on the worker thread, its progress is polled by wait_for_load like the progress
+  //    of the decoder
+  enum class cache_result : uint8_t
+  {
+    PUBLISHED,  // all selected messages were published from the cache
+    MISSED,     // no valid cache or not all selected messages in the cache
+    CANCELED    // loading was canceled by the user
+  };
+  std::vector<DecodedCache::series_source> published_series;   // all series published from the logfile
+  std::atomic<int> cache_progress{ -1 };                        // progress of reading or writing the cache (0-100%),
+                                                                // -1 while the cache is not accessed
+  std::atomic<bool> cache_canceled{ false };                    // indicator, if the progress dialog was canceled
+  static constexpr uint32_t CACHE_FLAG_LABEL_WITH_UNIT = 1;
+
+
+  // get the message selection of a previous load or ask the user to select from the given messages
+  //  - returns false, if loading was canceled by the user
+  bool resolve_selection(PJ::FileLoadInfo* info, const std::vector<APBinDecoder::message_info>& messages,
+                         const APBinDecoder::time_range& range, APBinDecoder::selection& selection,
+                         QProgressDialog& progress_dialog);
+
+  // publish the series of a logfile from its decoded cache (runs on the worker thread)
+  //  - the message selection is shown by the GUI thread, the worker waits for it
+  cache_result publish_from_cache(PJ::FileLoadInfo* info, const DecodedCache::cache_key& key,
+                                  PlotDataMapRef& plot_data, QProgressDialog& progress_dialog);
+
+  // write the published series of a logfile to its decoded cache (runs on the worker thread)
+  //  - a cancel of the progress dialog only aborts the write, the loaded series are kept
+  void write_cache(const PJ::FileLoadInfo* info, const DecodedCache::cache_key& key);
 };
\ No newline at end of file
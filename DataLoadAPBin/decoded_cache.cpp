@@ -0,0 +1,317 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Cache of the decoded series of a logfile for faster reloads.
+ *
+ */
+
+#include "decoded_cache.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+
+
+// FNV-1a hash of a byte sequence
+static uint64_t hash_bytes(const uint8_t* data, const uint64_t& size)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (uint64_t i = 0; i < size; i++)
+  {
+    hash ^= data[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+
+// append a value in native byte order
+template <typename T>
+static void append_value(std::string& out, const T& value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+static void append_string(std::string& out, const std::string& str)
+{
+  append_value(out, static_cast<uint16_t>(str.size()));
+  out.append(str);
+}
+
+
+// read a value in native byte order from [pos, end), returns false if the value exceeds end
+template <typename T>
+static bool read_value(const uint8_t*& pos, const uint8_t* end, T& value)
+{
+  if ( static_cast<uint64_t>(end - pos) < sizeof(T) )
+  {
+    return false;
+  }
+  memcpy(&value, pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+
+static bool read_string(const uint8_t*& pos, const uint8_t* end, std::string& str)
+{
+  uint16_t size = 0;
+  if ( !read_value(pos, end, size) || static_cast<uint64_t>(end - pos) < size )
+  {
+    return false;
+  }
+  str.assign(reinterpret_cast<const char*>(pos), size);
+  pos += size;
+  return true;
+}
+
+
+
+DecodedCache::cache_key DecodedCache::make_key(const QString& logfile, const uint8_t* buf, const uint64_t& len, const uint32_t& flags)
+{
+  cache_key key;
+  key.file_size = len;
+  key.file_mtime = QFileInfo(logfile).lastModified().toMSecsSinceEpoch();
+  key.header_hash = hash_bytes(buf, std::min(len, HEADER_HASH_SIZE));
+  key.flags = flags;
+  return key;
+}
+
+
+
+QStringList DecodedCache::get_paths(const QString& logfile)
+{
+  const QFileInfo logfile_info(logfile);
+
+  // the file name in the cache directory is unique for the path of the logfile
+  const QByteArray path = logfile_info.absoluteFilePath().toUtf8();
+  const uint64_t path_hash = hash_bytes(reinterpret_cast<const uint8_t*>(path.constData()), path.size());
+  const QString cache_dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/apbin";
+
+  return { logfile_info.absoluteFilePath() + ".pjcache",
+           cache_dir + "/" + logfile_info.fileName() + "." + QString::number(static_cast<qulonglong>(path_hash), 16) + ".pjcache" };
+}
+
+
+
+bool DecodedCache::open(const QString& logfile, const cache_key& key)
+{
+  close();
+
+  for (const QString& path : get_paths(logfile))
+  {
+    file.reset(new QFile(path));
+    if ( !file->open(QFile::ReadOnly) )
+    {
+      continue;
+    }
+
+    const uint64_t cache_size = static_cast<uint64_t>(file->size());
+    file_header header;
+    if ( cache_size < sizeof(file_header) || file->read(reinterpret_cast<char*>(&header), sizeof(file_header)) != static_cast<qint64>(sizeof(file_header)) )
+    {
+      continue;
+    }
+
+    // stale or foreign cache
+    if ( memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.flags != key.flags ||
+         header.file_size != key.file_size || header.file_mtime != key.file_mtime || header.header_hash != key.header_hash )
+    {
+      std::fprintf(stderr, "WARNING: cache %s is stale, it will be rebuilt!\n", path.toLocal8Bit().constData());
+      continue;
+    }
+    if ( header.cache_size != cache_size || header.data_offset > cache_size )
+    {
+      std::fprintf(stderr, "WARNING: cache %s is incomplete, it will be rebuilt!\n", path.toLocal8Bit().constData());
+      continue;
+    }
+
+    buf = file->map(0, static_cast<qint64>(cache_size));
+    if ( buf == nullptr )
+    {
+      continue;
+    }
+
+    range.first = header.time_first;
+    range.last = header.time_last;
+    range.has_utc = (header.has_utc != 0);
+    range.utc_offset = header.utc_offset;
+
+    // read the message and series tables
+    const uint8_t* pos = buf + sizeof(file_header);
+    const uint8_t* tables_end = buf + header.data_offset;
+    bool valid = true;
+
+    messages.resize(header.message_count);
+    for (auto& message : messages)
+    {
+      uint8_t decoded = 0;
+      valid = valid && read_string(pos, tables_end, message.name) && read_value(pos, tables_end, message.instances) &&
+              read_value(pos, tables_end, message.samples) && read_value(pos, tables_end, decoded);
+      message.decoded = (decoded != 0);
+    }
+
+    series.resize(header.series_count);
+    for (auto& entry : series)
+    {
+      uint64_t data_offset = 0;
+      valid = valid && read_string(pos, tables_end, entry.msg_name) && read_string(pos, tables_end, entry.name) &&
+              read_value(pos, tables_end, entry.samples) && read_value(pos, tables_end, data_offset);
+
+      // x and y of a series must be inside the cache: data_offset + 2 * sizeof(double) * samples <= cache_size
+      //  - data_offset is checked first, the size of the series is compared with the remaining bytes (no overflow)
+      valid = valid && data_offset % sizeof(double) == 0 && data_offset >= header.data_offset && data_offset <= cache_size &&
+              entry.samples <= (cache_size - data_offset) / (2 * sizeof(double));
+      if ( !valid )
+      {
+        break;
+      }
+      entry.x = reinterpret_cast<const double*>(buf + data_offset);
+      entry.y = entry.x + entry.samples;
+    }
+
+    if ( !valid )
+    {
+      std::fprintf(stderr, "WARNING: cache %s is corrupted, it will be rebuilt!\n", path.toLocal8Bit().constData());
+      close();
+      continue;
+    }
+
+    return true;
+  }
+
+  close();
+  return false;
+}
+
+
+
+void DecodedCache::close(void)
+{
+  if ( file && buf != nullptr )
+  {
+    file->unmap(const_cast<uint8_t*>(buf));
+  }
+  buf = nullptr;
+  file.reset();
+  messages.clear();
+  series.clear();
+  range = time_range();
+}
+
+
+
+bool DecodedCache::write(const QString& logfile, const cache_key& key, const std::vector<message_entry>& messages,
+                         const std::vector<series_source>& series, const time_range& range,
+                         const write_progress& report_progress)
+{
+  // -------------------- tables -------------------- //
+  std::string tables;
+  for (const auto& message : messages)
+  {
+    append_string(tables, message.name);
+    append_value(tables, message.instances);
+    append_value(tables, message.samples);
+    append_value(tables, static_cast<uint8_t>(message.decoded ? 1 : 0));
+  }
+
+  // the data of the series starts behind the tables (8 byte aligned)
+  uint64_t tables_size = tables.size();
+  for (const auto& source : series)
+  {
+    tables_size += sizeof(uint16_t) + source.msg_name.size() + sizeof(uint16_t) + source.name.size() + 2 * sizeof(uint64_t);
+  }
+  const uint64_t data_offset = (sizeof(file_header) + tables_size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+
+  uint64_t series_offset = data_offset;
+  for (const auto& source : series)
+  {
+    const uint64_t samples = source.data->size();
+    append_string(tables, source.msg_name);
+    append_string(tables, source.name);
+    append_value(tables, samples);
+    append_value(tables, series_offset);
+    series_offset += 2 * samples * sizeof(double);
+  }
+  tables.resize(data_offset - sizeof(file_header), '\0');
+
+  file_header header{};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.flags = key.flags;
+  header.file_size = key.file_size;
+  header.file_mtime = key.file_mtime;
+  header.header_hash = key.header_hash;
+  header.message_count = static_cast<uint32_t>(messages.size());
+  header.series_count = static_cast<uint32_t>(series.size());
+  header.data_offset = data_offset;
+  header.cache_size = series_offset;
+  header.time_first = range.first;
+  header.time_last = range.last;
+  header.utc_offset = range.utc_offset;
+  header.has_utc = range.has_utc ? 1 : 0;
+
+
+  // -------------------- write -------------------- //
+  // the cache is written to a temporary file and replaces the old cache only if it is complete
+  for (const QString& path : get_paths(logfile))
+  {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile cache_file(path);
+    if ( !cache_file.open(QFile::WriteOnly) )
+    {
+      continue;
+    }
+
+    bool written = cache_file.write(reinterpret_cast<const char*>(&header), sizeof(file_header)) == static_cast<qint64>(sizeof(file_header)) &&
+                   cache_file.write(tables.data(), tables.size()) == static_cast<qint64>(tables.size());
+
+    // x and y of each series, copied in blocks (the progress is reported after each block)
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    std::vector<double> block;
+    block.reserve(BLOCK_SIZE);
+    const uint64_t total_bytes = series_offset - data_offset;
+    uint64_t written_bytes = 0;
+    for (const auto& source : series)
+    {
+      const PJ::PlotData& data = *source.data;
+      for (int axis = 0; axis < 2 && written; axis++)
+      {
+        for (size_t begin = 0; begin < data.size() && written; begin += BLOCK_SIZE)
+        {
+          const size_t end = std::min(begin + BLOCK_SIZE, data.size());
+          block.clear();
+          for (size_t i = begin; i < end; i++)
+          {
+            block.push_back((axis == 0) ? data.at(i).x : data.at(i).y);
+          }
+          const qint64 block_bytes = static_cast<qint64>(block.size() * sizeof(double));
+          written = cache_file.write(reinterpret_cast<const char*>(block.data()), block_bytes) == block_bytes;
+
+          written_bytes += static_cast<uint64_t>(block_bytes);
+          if ( written && report_progress && !report_progress(static_cast<int>(100 * written_bytes / total_bytes)) )
+          {
+            // the uncommitted temporary file is discarded, the old cache is kept
+            return false;
+          }
+        }
+      }
+    }
+
+    if ( written && cache_file.commit() )
+    {
+      return true;
+    }
+    std::fprintf(stderr, "WARNING: can not write cache %s!\n", path.toLocal8Bit().constData());
+  }
+
+  return false;
+}
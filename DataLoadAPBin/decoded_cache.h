@@ -0,0 +1,150 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Cache of the decoded series of a logfile for faster reloads.
+ *
+ */
+
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "PlotJuggler/dataloader_base.h"
+
+
+/*
+The decoded cache holds the published series of a logfile (decoded, scaled and time-synced) in a memory mappable file.
+  - the cache is stored next to the logfile (<logfile>.pjcache) or, if that is not writable,
+    in the cache directory of the user
+  - the cache is keyed by the size, the modification time and a hash of the header region of the logfile,
+    a stale cache is detected and rebuilt by the next load
+  - all values are stored in the native byte order, a cache is only valid on the machine which wrote it
+
+Layout of the cache file:
+  - file_header
+  - message table:  name length (uint16), name, instances (uint32), samples (uint64), decoded (uint8)
+  - series table:   message name length (uint16), message name, name length (uint16), name,
+                    samples (uint64), byte-offset of the data (uint64)
+  - data:           x[samples], y[samples] (double) of each series, 8 byte aligned
+*/
+class DecodedCache
+{
+public:
+  struct cache_key
+  {
+    uint64_t file_size;
+    int64_t file_mtime;     // modification time of the logfile (ms since epoch)
+    uint64_t header_hash;   // hash of the header region of the logfile
+    uint32_t flags;         // loader configuration, which changes the series (e.g. LABEL_WITH_UNIT)
+  };
+
+  // metadata of a message type in the logfile (from the pre-scan)
+  struct message_entry
+  {
+    std::string name;
+    uint32_t instances;
+    uint64_t samples;
+    bool decoded;           // indicator, if the series of the message are in the cache
+  };
+
+  // time range of the logfile (from the pre-scan)
+  struct time_range
+  {
+    double first = 0;       // first timestamp (boot time in seconds)
+    double last = 0;        // last timestamp (boot time in seconds)
+    bool has_utc = false;   // indicator, if the GPS time of the logfile is known
+    double utc_offset = 0;  // offset between GPS time (UTC, unix time) and boot time
+  };
+
+  // series in the mapped cache
+  struct series_entry
+  {
+    std::string msg_name;
+    std::string name;
+    uint64_t samples;
+    const double* x;
+    const double* y;
+  };
+
+  // published series, which are written to the cache
+  struct series_source
+  {
+    std::string msg_name;
+    std::string name;
+    const PJ::PlotData* data;
+  };
+
+  // compute the key of a mapped logfile
+  static cache_key make_key(const QString& logfile, const uint8_t* buf, const uint64_t& len, const uint32_t& flags);
+
+  // map the cache of a logfile
+  //  - returns false, if there is no cache or the cache is stale
+  bool open(const QString& logfile, const cache_key& key);
+  void close(void);
+
+  const std::vector<message_entry>& get_messages(void) const
+  {
+    return messages;
+  }
+  const std::vector<series_entry>& get_series(void) const
+  {
+    return series;
+  }
+  const time_range& get_time_range(void) const
+  {
+    return range;
+  }
+
+  // called with the progress of writing the cache (0-100%), the write is aborted, if it returns false
+  typedef std::function<bool(const int& progress)> write_progress;
+
+  // write the cache of a logfile (replaces a stale cache)
+  //  - returns false, if the cache can not be written or the write was aborted (the old cache is kept)
+  static bool write(const QString& logfile, const cache_key& key, const std::vector<message_entry>& messages,
+                    const std::vector<series_source>& series, const time_range& range,
+                    const write_progress& report_progress = nullptr);
+
+private:
+  static constexpr char MAGIC[8] = { 'A', 'P', 'B', 'C', 'A', 'C', 'H', 'E' };
+  static constexpr uint32_t VERSION = 2;
+  static constexpr uint64_t HEADER_HASH_SIZE = 1024 * 1024;   // size of the hashed header region of the logfile
+
+  struct file_header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint64_t header_hash;
+    uint32_t message_count;
+    uint32_t series_count;
+    uint64_t data_offset;     // byte-offset of the data of the first series
+    uint64_t cache_size;      // size of the whole cache file (detects truncated caches)
+    double time_first;        // time range of the logfile (see time_range)
+    double time_last;
+    double utc_offset;
+    uint32_t has_utc;
+    uint32_t reserved;
+  };
+
+  std::unique_ptr<QFile> file;
+  const uint8_t* buf = nullptr;
+  std::vector<message_entry> messages;
+  std::vector<series_entry> series;
+  time_range range;
+
+  // get the possible locations of the cache of a logfile (sidecar file first)
+  static QStringList get_paths(const QString& logfile);
+};
@@ -0,0 +1,399 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Dialog to select the messages, which are decoded from a logfile.
+ *
+ */
+
+#include "dialog_select_messages.h"
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QDoubleSpinBox>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QPushButton>
+#include <QRegularExpression>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+
+// columns of the message table
+static constexpr int COLUMN_NAME = 0;
+static constexpr int COLUMN_INSTANCES = 1;
+static constexpr int COLUMN_SAMPLES = 2;
+
+// entries of the time base combo box
+static constexpr int TIME_BASE_BOOT = 0;
+static constexpr int TIME_BASE_UTC = 1;
+
+
+DialogSelectMessages::DialogSelectMessages(const std::vector<message_info>& messages, const QStringList& selection,
+                                           const time_range& range, const time_window& window, const decimation& decimation,
+                                           const QStringList& logfiles, QWidget* parent)
+  : QDialog(parent), range(range)
+{
+  setWindowTitle("ArduPilot logfile: select messages");
+
+  // -------------------- message table -------------------- //
+  table = new QTableWidget(static_cast<int>(messages.size()), 3, this);
+  table->setHorizontalHeaderLabels({ "Message", "Instances", "Samples" });
+  table->verticalHeader()->setVisible(false);
+  table->horizontalHeader()->setSectionResizeMode(COLUMN_NAME, QHeaderView::Stretch);
+  table->setSelectionMode(QAbstractItemView::NoSelection);
+  table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+  for (int row = 0; row < static_cast<int>(messages.size()); row++)
+  {
+    const message_info& message = messages[row];
+
+    const QString name = QString::fromStdString(message.name);
+    QTableWidgetItem* name_item = new QTableWidgetItem(name);
+    name_item->setFlags(Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+    name_item->setCheckState(matches(selection, name) ? Qt::Checked : Qt::Unchecked);
+    table->setItem(row, COLUMN_NAME, name_item);
+
+    // numbers are stored as data, so that the columns are sorted numerically
+    QTableWidgetItem* instances_item = new QTableWidgetItem();
+    instances_item->setFlags(Qt::ItemIsEnabled);
+    instances_item->setData(Qt::DisplayRole, message.instances);
+    table->setItem(row, COLUMN_INSTANCES, instances_item);
+
+    QTableWidgetItem* samples_item = new QTableWidgetItem();
+    samples_item->setFlags(Qt::ItemIsEnabled);
+    samples_item->setData(Qt::DisplayRole, static_cast<qulonglong>(message.samples));
+    table->setItem(row, COLUMN_SAMPLES, samples_item);
+  }
+  table->setSortingEnabled(true);
+  table->sortItems(COLUMN_NAME);
+
+
+  // -------------------- selection by pattern -------------------- //
+  pattern_edit = new QLineEdit(this);
+  pattern_edit->setPlaceholderText("e.g. ATT RATE PID*");
+
+  QPushButton* matching_button = new QPushButton("Select matching", this);
+  QPushButton* all_button = new QPushButton("Select all", this);
+  QPushButton* none_button = new QPushButton("Select none", this);
+  for (QPushButton* button : { matching_button, all_button, none_button })
+  {
+    // enter in the pattern field accepts the dialog
+    button->setAutoDefault(false);
+  }
+  connect(matching_button, &QPushButton::clicked, this, [this]() { select_matching(); });
+  connect(all_button, &QPushButton::clicked, this, [this]() { select_all(true); });
+  connect(none_button, &QPushButton::clicked, this, [this]() { select_all(false); });
+
+  QHBoxLayout* pattern_layout = new QHBoxLayout();
+  pattern_layout->addWidget(pattern_edit);
+  pattern_layout->addWidget(matching_button);
+  pattern_layout->addWidget(all_button);
+  pattern_layout->addWidget(none_button);
+
+
+  // -------------------- time window -------------------- //
+  window_check = new QCheckBox("Load only the time window (s):", this);
+  time_base_combo = new QComboBox(this);
+  time_base_combo->addItem("Boot time");
+  time_base_combo->addItem("GPS time (UTC)");
+  start_spin = new QDoubleSpinBox(this);
+  end_spin = new QDoubleSpinBox(this);
+  for (QDoubleSpinBox* spin : { start_spin, end_spin })
+  {
+    spin->setDecimals(3);
+  }
+
+  // the time window is given in boot time, until the user selects another time base
+  start_spin->setRange(range.first, range.last);
+  end_spin->setRange(range.first, range.last);
+  start_spin->setValue(range.first);
+  end_spin->setValue(range.last);
+  if ( window.enabled )
+  {
+    const double offset = (window.utc && range.has_utc) ? range.utc_offset : 0;
+    start_spin->setValue(window.start - offset);
+    end_spin->setValue(window.end - offset);
+  }
+  if ( window.utc && range.has_utc )
+  {
+    time_base_combo->setCurrentIndex(TIME_BASE_UTC);
+    set_time_base(true);
+  }
+  connect(time_base_combo, QOverload<int>::of(&QComboBox::currentIndexChanged), this,
+          [this](int index) { set_time_base(index == TIME_BASE_UTC); });
+
+  // the time window is only available, if the pre-scan found timestamps
+  const bool has_time_range = range.last > range.first;
+  window_check->setChecked(window.enabled && has_time_range);
+  window_check->setEnabled(has_time_range);
+  time_base_combo->setEnabled(has_time_range && range.has_utc);
+  start_spin->setEnabled(has_time_range);
+  end_spin->setEnabled(has_time_range);
+
+  QHBoxLayout* window_layout = new QHBoxLayout();
+  window_layout->addWidget(window_check);
+  window_layout->addWidget(start_spin);
+  window_layout->addWidget(new QLabel("to", this));
+  window_layout->addWidget(end_spin);
+  window_layout->addWidget(time_base_combo);
+
+
+  // -------------------- decimation -------------------- //
+  decimation_check = new QCheckBox("Decimate messages above (Hz):", this);
+  decimation_check->setToolTip("Keeps the minimum and maximum sample of each time bucket, so that spikes are preserved");
+  decimation_check->setChecked(decimation.enabled);
+  rate_spin = new QDoubleSpinBox(this);
+  rate_spin->setDecimals(1);
+  rate_spin->setRange(1, 100000);
+  rate_spin->setValue(decimation.max_rate);
+
+  // the rate or the budget of points of single messages (e.g. IMU at a higher rate, GPS untouched)
+  rules_edit = new QLineEdit(format_rules(decimation.rules), this);
+  rules_edit->setPlaceholderText("per message, e.g. IMU*=400 BARO=5000pts GPS*=0");
+  rules_edit->setToolTip("Maximum rate (Hz) or points per series (pts) of the matching messages, the first matching "
+                         "pattern applies, 0 keeps all samples");
+
+  QHBoxLayout* decimation_layout = new QHBoxLayout();
+  decimation_layout->addWidget(decimation_check);
+  decimation_layout->addWidget(rate_spin);
+  decimation_layout->addWidget(rules_edit);
+
+
+  // -------------------- further logfiles -------------------- //
+  logfile_list = new QListWidget(this);
+  logfile_list->addItems(logfiles);
+  logfile_list->setMaximumHeight(80);
+  logfile_list->setToolTip("The logfiles are loaded at the same time, their series are placed under /<logfile stem>/");
+
+  QPushButton* add_logfiles_button = new QPushButton("Add logfiles...", this);
+  QPushButton* clear_logfiles_button = new QPushButton("Clear", this);
+  for (QPushButton* button : { add_logfiles_button, clear_logfiles_button })
+  {
+    button->setAutoDefault(false);
+  }
+  connect(add_logfiles_button, &QPushButton::clicked, this, [this]() { add_logfiles(); });
+  connect(clear_logfiles_button, &QPushButton::clicked, logfile_list, &QListWidget::clear);
+
+  QVBoxLayout* logfile_buttons_layout = new QVBoxLayout();
+  logfile_buttons_layout->addWidget(add_logfiles_button);
+  logfile_buttons_layout->addWidget(clear_logfiles_button);
+  logfile_buttons_layout->addStretch();
+
+  QHBoxLayout* logfile_layout = new QHBoxLayout();
+  logfile_layout->addWidget(logfile_list);
+  logfile_layout->addLayout(logfile_buttons_layout);
+
+
+  // -------------------- dialog -------------------- //
+  QDialogButtonBox* button_box = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+  connect(button_box, &QDialogButtonBox::accepted, this, &QDialog::accept);
+  connect(button_box, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+  QVBoxLayout* layout = new QVBoxLayout(this);
+  layout->addWidget(new QLabel("Only the checked messages are decoded:", this));
+  layout->addWidget(table);
+  layout->addLayout(pattern_layout);
+  layout->addLayout(window_layout);
+  layout->addLayout(decimation_layout);
+  layout->addWidget(new QLabel("Load further logfiles with the same selection:", this));
+  layout->addLayout(logfile_layout);
+  layout->addWidget(button_box);
+
+  resize(520, 720);
+}
+
+
+
+QStringList DialogSelectMessages::get_selection(void) const
+{
+  QStringList selection;
+  for (int row = 0; row < table->rowCount(); row++)
+  {
+    const QTableWidgetItem* name_item = table->item(row, COLUMN_NAME);
+    if ( name_item->checkState() == Qt::Checked )
+    {
+      selection.append(name_item->text());
+    }
+  }
+  return selection;
+}
+
+
+
+bool DialogSelectMessages::matches(const QStringList& patterns, const QString& name)
+{
+  // the same matching as the decoder applies to the selection
+  std::vector<std::string> std_patterns;
+  for (const QString& pattern : patterns)
+  {
+    std_patterns.push_back(pattern.toStdString());
+  }
+  return APBinDecoder::matches(std_patterns, name.toStdString());
+}
+
+
+
+void DialogSelectMessages::select_matching(void)
+{
+  // patterns are separated by spaces or commas
+  const QStringList patterns = pattern_edit->text().split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts);
+
+  for (int row = 0; row < table->rowCount(); row++)
+  {
+    QTableWidgetItem* name_item = table->item(row, COLUMN_NAME);
+    if ( matches(patterns, name_item->text()) )
+    {
+      name_item->setCheckState(Qt::Checked);
+    }
+  }
+}
+
+
+
+void DialogSelectMessages::select_all(const bool& checked)
+{
+  for (int row = 0; row < table->rowCount(); row++)
+  {
+    table->item(row, COLUMN_NAME)->setCheckState(checked ? Qt::Checked : Qt::Unchecked);
+  }
+}
+
+
+
+DialogSelectMessages::time_window DialogSelectMessages::get_time_window(void) const
+{
+  time_window window;
+  window.enabled = window_check->isChecked();
+  window.utc = (time_base_combo->currentIndex() == TIME_BASE_UTC);
+  window.start = start_spin->value();
+  window.end = end_spin->value();
+  return window;
+}
+
+
+
+DialogSelectMessages::decimation DialogSelectMessages::get_decimation(void) const
+{
+  decimation selected;
+  selected.enabled = decimation_check->isChecked();
+  selected.max_rate = rate_spin->value();
+  selected.rules = parse_rules(rules_edit->text());
+  return selected;
+}
+
+
+
+std::vector<DialogSelectMessages::decimation_rule> DialogSelectMessages::parse_rules(const QString& text)
+{
+  std::vector<decimation_rule> rules;
+  for (const QString& token : text.split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts))
+  {
+    const int separator = token.lastIndexOf('=');
+    if ( separator <= 0 )
+    {
+      continue;
+    }
+
+    decimation_rule rule;
+    rule.pattern = token.left(separator).toStdString();
+    bool valid = true;
+    for (QString limit : token.mid(separator + 1).split('/'))
+    {
+      bool ok = false;
+      if ( limit.endsWith("pts") )
+      {
+        limit.chop(3);
+        rule.max_points = limit.toULongLong(&ok);
+      }
+      else
+      {
+        rule.max_rate = limit.toDouble(&ok);
+      }
+      valid = valid && ok;
+    }
+
+    // malformed rules are dropped, like unknown patterns of the message selection
+    if ( valid )
+    {
+      rules.push_back(rule);
+    }
+  }
+  return rules;
+}
+
+
+
+QString DialogSelectMessages::format_rules(const std::vector<decimation_rule>& rules)
+{
+  QStringList tokens;
+  for (const auto& rule : rules)
+  {
+    QStringList limits;
+    if ( rule.max_rate > 0 )
+    {
+      limits.append(QString::number(rule.max_rate));
+    }
+    if ( rule.max_points > 0 )
+    {
+      limits.append(QString::number(static_cast<qulonglong>(rule.max_points)) + "pts");
+    }
+    if ( limits.isEmpty() )
+    {
+      limits.append("0");
+    }
+    tokens.append(QString::fromStdString(rule.pattern) + "=" + limits.join('/'));
+  }
+  return tokens.join(' ');
+}
+
+
+
+void DialogSelectMessages::set_time_base(const bool& utc)
+{
+  // the spin boxes keep the same point in time
+  const double offset = utc ? range.utc_offset : -range.utc_offset;
+  const double start = start_spin->value() + offset;
+  const double end = end_spin->value() + offset;
+
+  const double range_offset = utc ? range.utc_offset : 0;
+  start_spin->setRange(range.first + range_offset, range.last + range_offset);
+  end_spin->setRange(range.first + range_offset, range.last + range_offset);
+  start_spin->setValue(start);
+  end_spin->setValue(end);
+}
+
+
+
+QStringList DialogSelectMessages::get_logfiles(void) const
+{
+  QStringList logfiles;
+  for (int row = 0; row < logfile_list->count(); row++)
+  {
+    logfiles.append(logfile_list->item(row)->text());
+  }
+  return logfiles;
+}
+
+
+
+void DialogSelectMessages::add_logfiles(void)
+{
+  const QStringList logfiles = QFileDialog::getOpenFileNames(this, "Load further logfiles", QString(),
+                                                             "ArduPilot logfiles (*.BIN *.bin *.gz *.zst *.lz4);;All files (*)");
+  for (const QString& logfile : logfiles)
+  {
+    if ( logfile_list->findItems(logfile, Qt::MatchExactly).isEmpty() )
+    {
+      logfile_list->addItem(logfile);
+    }
+  }
+}
@@ -0,0 +1,93 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Dialog to select the messages, which are decoded from a logfile.
+ *
+ */
+
+#pragma once
+
+#include <QDialog>
+#include <QStringList>
+#include <cstdint>
+#include <vector>
+#include "apbin_decoder.h"
+
+class QCheckBox;
+class QComboBox;
+class QDoubleSpinBox;
+class QLineEdit;
+class QListWidget;
+class QTableWidget;
+
+class DialogSelectMessages : public QDialog
+{
+public:
+  // metadata of the messages, time range of the logfile, time window and decimation (see apbin_decoder.h)
+  typedef APBinDecoder::message_info message_info;
+  typedef APBinDecoder::time_range time_range;
+  typedef APBinDecoder::time_window time_window;
+  typedef APBinDecoder::decimation_settings decimation;
+  typedef APBinDecoder::decimation_rule decimation_rule;
+
+  // the messages matching the given selection are checked initially
+  //  - the time window can only be changed, if the time range of the logfile is known (last > first)
+  //  - further logfiles can be added, which are loaded with the same selection (e.g. to compare flights)
+  DialogSelectMessages(const std::vector<message_info>& messages, const QStringList& selection,
+                       const time_range& range, const time_window& window, const decimation& decimation,
+                       const QStringList& logfiles, QWidget* parent = nullptr);
+
+  // get the names of all checked messages
+  QStringList get_selection(void) const;
+
+  // get the selected time window
+  time_window get_time_window(void) const;
+
+  // get the selected decimation
+  decimation get_decimation(void) const;
+
+  // get the logfiles, which are loaded together with the opened logfile
+  QStringList get_logfiles(void) const;
+
+  // check if a message name matches one of the patterns (wildcards '*', '?' and '[...]' allowed)
+  static bool matches(const QStringList& patterns, const QString& name);
+
+private:
+  QLineEdit* pattern_edit;
+  QTableWidget* table;
+
+  time_range range;
+  QCheckBox* window_check;
+  QComboBox* time_base_combo;
+  QDoubleSpinBox* start_spin;
+  QDoubleSpinBox* end_spin;
+
+  QCheckBox* decimation_check;
+  QDoubleSpinBox* rate_spin;
+  QLineEdit* rules_edit;
+
+  QListWidget* logfile_list;
+
+  // check all messages, which match the patterns of pattern_edit
+  void select_matching(void);
+
+  // check or uncheck all messages
+  void select_all(const bool& checked);
+
+  // change the time base of the time window (boot time or GPS time)
+  void set_time_base(const bool& utc);
+
+  // ask the user for further logfiles and add them to logfile_list
+  void add_logfiles(void);
+
+  // convert the decimation rules from and to the text of rules_edit
+  //  - PATTERN=RATE (Hz), PATTERN=POINTSpts or PATTERN=RATE/POINTSpts, separated by spaces or commas
+  //  - PATTERN=0 keeps all samples of the matching messages
+  static std::vector<decimation_rule> parse_rules(const QString& text);
+  static QString format_rules(const std::vector<decimation_rule>& rules);
+};
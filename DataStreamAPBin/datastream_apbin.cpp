@@ -0,0 +1,323 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries streamer for Plotjuggler.
+ * This decodes ArduPilot DataFlash binaries, which are still being written (bench and HIL tests), while they grow:
+ * a logfile is followed on disk or its blocks are received from a local UDP port.
+ *
+ */
+
+#include "datastream_apbin.h"
+#include <QDomDocument>
+#include <QFile>
+#include <QFileInfo>
+#include <QMessageBox>
+#include <QRegularExpression>
+#include <QUdpSocket>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+#ifdef Q_OS_UNIX
+  #include <sys/stat.h>
+#endif
+
+
+DataStreamAPBIN::~DataStreamAPBIN()
+{
+  shutdown();
+}
+
+
+
+bool DataStreamAPBIN::start(QStringList* selected_datasources)
+{
+  (void)selected_datasources;
+  if ( running )
+  {
+    return true;
+  }
+
+  DialogStreamSource dialog(settings);
+  if ( dialog.exec() != QDialog::Accepted )
+  {
+    return false;
+  }
+  settings = dialog.get_settings();
+
+  // patterns are separated by spaces or commas, like in the message selection of the loader
+  APBinDecoder::selection selection;
+  selection.messages.clear();
+  for (const QString& pattern : settings.messages.split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts))
+  {
+    selection.messages.push_back(pattern.toStdString());
+  }
+  if ( selection.messages.empty() )
+  {
+    selection.messages.push_back("*");
+  }
+  decoder.set_selection(selection);
+  read_buffer.resize(READ_BLOCK_SIZE);
+
+  if ( settings.type == source_type::FILE )
+  {
+    if ( !QFile::exists(settings.filename) )
+    {
+      QMessageBox::warning(nullptr, "ArduPilot live logfile", QString("Logfile %1 does not exist!").arg(settings.filename));
+      return false;
+    }
+    running = true;
+    worker = std::thread([this]() { follow_file(); });
+    return true;
+  }
+
+  // the socket is bound by the worker thread, which owns it, the result is awaited here
+  std::atomic<bool> bound{ false };
+  QString bind_error;
+  running = true;
+  worker = std::thread([this, &bound, &bind_error]() { receive_udp(bound, bind_error); });
+  while ( !bound )
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if ( !bind_error.isEmpty() )
+  {
+    running = false;
+    worker.join();
+    QMessageBox::warning(nullptr, "ArduPilot live logfile",
+                         QString("Can not receive on UDP port %1: %2").arg(settings.port).arg(bind_error));
+    return false;
+  }
+  return true;
+}
+
+
+
+void DataStreamAPBIN::shutdown()
+{
+  running = false;
+  if ( !worker.joinable() )
+  {
+    return;
+  }
+  worker.join();
+
+  APBinDecoder::load_report report;
+  decoder.get_live_report(report);
+  std::printf("\n  Read messages:\t%d", report.msgs_read);
+  std::printf("\n  Skipped messages:\t%d", report.msgs_skipped);
+  std::printf("\n  Skipped bytes:\t%" PRIu64 " from %" PRIu64 " bytes\n\n", report.bytes_skipped, report.bytes);
+}
+
+
+
+void DataStreamAPBIN::follow_file(void)
+{
+  QFile file(settings.filename);
+  restart_logfile();
+
+  while ( running )
+  {
+    // the logfile may not exist for a moment, while it is replaced
+    if ( !file.isOpen() )
+    {
+      if ( !file.open(QIODevice::ReadOnly | QIODevice::Unbuffered) )
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+        continue;
+      }
+      followed_birth_time = QFileInfo(settings.filename).birthTime();
+    }
+
+    const qint64 count = file.read(reinterpret_cast<char*>(read_buffer.data()), READ_BLOCK_SIZE);
+    if ( count < 0 )
+    {
+      std::fprintf(stderr, "WARNING: can not read logfile %s: %s\n", settings.filename.toLocal8Bit().constData(),
+                   file.errorString().toLocal8Bit().constData());
+      file.close();
+      restart_logfile();
+    }
+    else if ( count == static_cast<qint64>(READ_BLOCK_SIZE) )
+    {
+      // a full block is followed by the next one right away, until the end of the logfile is reached
+      decode_block(read_buffer.data(), static_cast<size_t>(count));
+      continue;
+    }
+    else
+    {
+      if ( count > 0 )
+      {
+        decode_block(read_buffer.data(), static_cast<size_t>(count));
+      }
+
+      // at the end of the logfile, a logfile which was replaced under its name (e.g. the logger started a new
+      // logfile) or which shrinks is decoded again from its beginning
+      if ( logfile_replaced(file) )
+      {
+        file.close();
+        restart_logfile();
+        continue;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+  }
+}
+
+
+
+bool DataStreamAPBIN::logfile_replaced(const QFile& file) const
+{
+  // the open file keeps the previous logfile, the name is checked for a new one
+  const QFileInfo named(settings.filename);
+  if ( !named.exists() )
+  {
+    return false;
+  }
+  if ( named.size() < file.pos() || named.birthTime() != followed_birth_time )
+  {
+    return true;
+  }
+
+  #ifdef Q_OS_UNIX
+    // the birth time is not available on every file system, the inode identifies the file
+    struct stat opened_stat, named_stat;
+    if ( ::fstat(file.handle(), &opened_stat) == 0 && ::stat(settings.filename.toLocal8Bit().constData(), &named_stat) == 0 )
+    {
+      return opened_stat.st_dev != named_stat.st_dev || opened_stat.st_ino != named_stat.st_ino;
+    }
+  #endif
+  return false;
+}
+
+
+
+void DataStreamAPBIN::receive_udp(std::atomic<bool>& bound, QString& bind_error)
+{
+  QUdpSocket socket;
+  if ( !socket.bind(QHostAddress::LocalHost, settings.port) )
+  {
+    bind_error = socket.errorString();
+  }
+  // start() returns after this, bound and bind_error must not be used any more
+  const bool failed = !bind_error.isEmpty();
+  bound = true;
+  if ( failed )
+  {
+    return;
+  }
+  restart_logfile();
+
+  // every datagram holds the next bytes of the logfile, a lost datagram is skipped like a corrupted part of a logfile
+  while ( running )
+  {
+    if ( !socket.waitForReadyRead(POLL_INTERVAL_MS) )
+    {
+      continue;
+    }
+
+    // all pending datagrams are decoded at once
+    size_t used = 0;
+    while ( socket.hasPendingDatagrams() && used < READ_BLOCK_SIZE )
+    {
+      const qint64 size = socket.pendingDatagramSize();
+      if ( size < 0 )
+      {
+        break;
+      }
+      if ( used + size > read_buffer.size() )
+      {
+        read_buffer.resize(used + size);
+      }
+      const qint64 count = socket.readDatagram(reinterpret_cast<char*>(&read_buffer[used]), size);
+      if ( count > 0 )
+      {
+        used += count;
+      }
+    }
+    if ( used > 0 )
+    {
+      decode_block(read_buffer.data(), used);
+    }
+  }
+}
+
+
+
+void DataStreamAPBIN::decode_block(const uint8_t* buf, const size_t& len)
+{
+  uint64_t decoded = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex());
+    PlotDataSink sink(dataMap());
+    decoded = decoder.decode_live(buf, len, sink);
+  }
+  if ( decoded > 0 )
+  {
+    emit dataReceived();
+  }
+}
+
+
+
+void DataStreamAPBIN::restart_logfile(void)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex());
+    decoder.begin_live();
+
+    // the series are kept, so that the plots of the previous logfile stay configured
+    for (auto& series : dataMap().numeric)
+    {
+      series.second.clear();
+    }
+  }
+  emit dataReceived();
+}
+
+
+
+void* DataStreamAPBIN::PlotDataSink::add_series(const std::string& msg_name, const std::string& series_name)
+{
+  (void)msg_name;
+  return &plot_data.addNumeric(series_name)->second;
+}
+
+
+
+void DataStreamAPBIN::PlotDataSink::append(void* series, const double& time, const double& value)
+{
+  static_cast<PlotData*>(series)->pushBack(PlotData::Point(time, value));
+}
+
+
+
+bool DataStreamAPBIN::xmlSaveState(QDomDocument& doc, QDomElement& parent_element) const
+{
+  QDomElement source_elem = doc.createElement("source");
+  source_elem.setAttribute("type", (settings.type == source_type::UDP) ? "udp" : "file");
+  source_elem.setAttribute("filename", settings.filename);
+  source_elem.setAttribute("port", settings.port);
+  source_elem.setAttribute("messages", settings.messages);
+  parent_element.appendChild(source_elem);
+  return true;
+}
+
+
+
+bool DataStreamAPBIN::xmlLoadState(const QDomElement& parent_element)
+{
+  const QDomElement source_elem = parent_element.firstChildElement("source");
+  if ( source_elem.isNull() )
+  {
+    return true;
+  }
+  settings.type = (source_elem.attribute("type") == "udp") ? source_type::UDP : source_type::FILE;
+  settings.filename = source_elem.attribute("filename");
+  settings.port = static_cast<uint16_t>(source_elem.attribute("port", QString::number(settings.port)).toUInt());
+  settings.messages = source_elem.attribute("messages", settings.messages);
+  return true;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries streamer for Plotjuggler.
+ * This decodes ArduPilot DataFlash binaries, which are still being written (bench and HIL tests), while they grow:
+ * a logfile is followed on disk or its blocks are received from a local UDP port.
+ *
+ */
+
+#pragma once
+
+#include <QDateTime>
+#include <QFile>
+#include <QObject>
+#include <QtPlugin>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "PlotJuggler/datastreamer_base.h"
+#include "apbin_decoder.h"
+#include "dialog_stream_source.h"
+
+using namespace PJ;
+
+class DataStreamAPBIN : public DataStreamer
+{
+  Q_OBJECT
+  Q_PLUGIN_METADATA(IID "facontidavide.PlotJuggler3.DataStreamer")
+  Q_INTERFACES(PJ::DataStreamer)
+
+public:
+  DataStreamAPBIN() = default;
+
+  ~DataStreamAPBIN() override;
+
+  bool start(QStringList* selected_datasources) override;
+
+  void shutdown() override;
+
+  bool isRunning() const override
+  {
+    return running;
+  }
+
+  virtual const char* name() const override
+  {
+    return "ArduPilot Bin Live";
+  }
+
+  virtual bool isDebugPlugin() override
+  {
+    return false;
+  }
+
+  // the source and the message selection are stored in the layout
+  bool xmlSaveState(QDomDocument& doc, QDomElement& parent_element) const override;
+  bool xmlLoadState(const QDomElement& parent_element) override;
+
+private:
+  typedef DialogStreamSource::source_type source_type;
+  DialogStreamSource::stream_settings settings;
+
+
+  // decoder of the logfile (see apbin_decoder.h), only used by the worker thread while streaming
+  APBinDecoder decoder;
+
+
+  // streaming handling variables
+  //  - the worker thread reads the appended bytes of the source and decodes them straight into the series
+  //  - the source is polled in this interval, so appended samples are published within a few tens of milliseconds
+  //  - at most READ_BLOCK_SIZE bytes are decoded at once, so catching up with a large logfile never blocks the
+  //    series (mutex) for long
+  static constexpr int POLL_INTERVAL_MS = 20;
+  static constexpr size_t READ_BLOCK_SIZE = 4 * 1024 * 1024;
+  std::thread worker;
+  std::atomic<bool> running{ false };
+  std::vector<uint8_t> read_buffer;
+  QDateTime followed_birth_time;  // birth time of the followed logfile (invalid, if the file system has none)
+
+  // follow a growing logfile, a logfile which is replaced under its name or shrinks is decoded again from its beginning
+  void follow_file(void);
+
+  // check if the followed logfile was replaced under its name (other file) or shrinks (rewritten in place)
+  bool logfile_replaced(const QFile& file) const;
+
+  // receive the blocks of a logfile from the local UDP port
+  //  - bound is set after the socket was bound (or binding failed, see bind_error)
+  void receive_udp(std::atomic<bool>& bound, QString& bind_error);
+
+  // decode the appended bytes into the series and notify plotjuggler
+  void decode_block(const uint8_t* buf, const size_t& len);
+
+  // start the decoding of a new logfile, the samples of the previous logfile are cleared
+  void restart_logfile(void);
+
+
+  // sink of the decoder, which appends the decoded samples to the series of the streamer
+  class PlotDataSink : public APBinSink
+  {
+  public:
+    explicit PlotDataSink(PlotDataMapRef& plot_data) : plot_data(plot_data)
+    {
+    }
+
+    void* add_series(const std::string& msg_name, const std::string& series_name) override;
+    void append(void* series, const double& time, const double& value) override;
+
+  private:
+    PlotDataMapRef& plot_data;
+  };
+};
@@ -0,0 +1,115 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries streamer for Plotjuggler.
+ * Dialog to select the source of a live logfile (growing file or UDP port) and the messages to decode.
+ *
+ */
+
+#include "dialog_stream_source.h"
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QVBoxLayout>
+
+
+// entries of the source combo box
+static constexpr int SOURCE_FILE = 0;
+static constexpr int SOURCE_UDP = 1;
+
+
+DialogStreamSource::DialogStreamSource(const stream_settings& settings, QWidget* parent)
+  : QDialog(parent)
+{
+  setWindowTitle("ArduPilot live logfile");
+
+  // -------------------- source -------------------- //
+  source_combo = new QComboBox(this);
+  source_combo->addItem("Follow a growing logfile");
+  source_combo->addItem("Receive logfile blocks over UDP");
+
+  file_edit = new QLineEdit(settings.filename, this);
+  browse_button = new QPushButton("Browse...", this);
+  connect(browse_button, &QPushButton::clicked, this, [this]() { browse(); });
+
+  QHBoxLayout* file_layout = new QHBoxLayout();
+  file_layout->addWidget(file_edit);
+  file_layout->addWidget(browse_button);
+
+  // the blocks are only received on the local host
+  port_spin = new QSpinBox(this);
+  port_spin->setRange(1, 65535);
+  port_spin->setValue(settings.port);
+
+
+  // -------------------- messages -------------------- //
+  messages_edit = new QLineEdit(settings.messages, this);
+  messages_edit->setToolTip("Names or wildcard patterns of the decoded messages, e.g. \"ATT RATE PID*\"");
+
+
+  // -------------------- dialog -------------------- //
+  QFormLayout* form_layout = new QFormLayout();
+  form_layout->addRow("Source:", source_combo);
+  form_layout->addRow("Logfile:", file_layout);
+  form_layout->addRow("UDP port (localhost):", port_spin);
+  form_layout->addRow("Messages:", messages_edit);
+
+  QDialogButtonBox* button_box = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+  connect(button_box, &QDialogButtonBox::accepted, this, &QDialog::accept);
+  connect(button_box, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+  QVBoxLayout* layout = new QVBoxLayout(this);
+  layout->addLayout(form_layout);
+  layout->addWidget(new QLabel("The logfile is decoded from its beginning, appended data is published as it arrives.", this));
+  layout->addWidget(button_box);
+
+  connect(source_combo, QOverload<int>::of(&QComboBox::currentIndexChanged), this,
+          [this](int index) { set_source((index == SOURCE_UDP) ? source_type::UDP : source_type::FILE); });
+  source_combo->setCurrentIndex((settings.type == source_type::UDP) ? SOURCE_UDP : SOURCE_FILE);
+  set_source(settings.type);
+
+  resize(520, 0);
+}
+
+
+
+DialogStreamSource::stream_settings DialogStreamSource::get_settings(void) const
+{
+  stream_settings settings;
+  settings.type = (source_combo->currentIndex() == SOURCE_UDP) ? source_type::UDP : source_type::FILE;
+  settings.filename = file_edit->text();
+  settings.port = static_cast<uint16_t>(port_spin->value());
+  settings.messages = messages_edit->text();
+  return settings;
+}
+
+
+
+void DialogStreamSource::set_source(const source_type& type)
+{
+  file_edit->setEnabled(type == source_type::FILE);
+  browse_button->setEnabled(type == source_type::FILE);
+  port_spin->setEnabled(type == source_type::UDP);
+}
+
+
+
+void DialogStreamSource::browse(void)
+{
+  const QString filename = QFileDialog::getOpenFileName(this, "Select the logfile", file_edit->text(),
+                                                        "ArduPilot logfiles (*.bin *.BIN);;All files (*)");
+  if ( !filename.isEmpty() )
+  {
+    file_edit->setText(filename);
+  }
+}
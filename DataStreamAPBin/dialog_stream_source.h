@@ -0,0 +1,60 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries streamer for Plotjuggler.
+ * Dialog to select the source of a live logfile (growing file or UDP port) and the messages to decode.
+ *
+ */
+
+#pragma once
+
+#include <QDialog>
+#include <QString>
+#include <cstdint>
+
+class QComboBox;
+class QLineEdit;
+class QPushButton;
+class QSpinBox;
+
+class DialogStreamSource : public QDialog
+{
+public:
+  // source of the live logfile
+  enum class source_type : uint8_t
+  {
+    FILE,   // a logfile, which is still being written, is followed
+    UDP     // the blocks of a logfile are received from a local UDP port
+  };
+
+  // settings of a stream
+  struct stream_settings
+  {
+    source_type type = source_type::FILE;
+    QString filename;
+    uint16_t port = 14560;
+    QString messages = "*";   // names or wildcard patterns, separated by spaces or commas
+  };
+
+  DialogStreamSource(const stream_settings& settings, QWidget* parent = nullptr);
+
+  // get the selected settings
+  stream_settings get_settings(void) const;
+
+private:
+  QComboBox* source_combo;
+  QLineEdit* file_edit;
+  QPushButton* browse_button;
+  QSpinBox* port_spin;
+  QLineEdit* messages_edit;
+
+  // enable the widgets of the selected source
+  void set_source(const source_type& type);
+
+  // select the logfile with a file dialog
+  void browse(void);
+};
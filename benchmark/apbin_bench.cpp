@@ -0,0 +1,280 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Headless benchmark of the decoder: decodes a logfile without any dialog and reports the throughput.
+ *
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "apbin_decoder.h"
+#include "compressed_logfile.h"
+#include "mapped_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+
+// sink, which stores the decoded series in memory like plotjuggler (a vector of points per series)
+class VectorSink : public APBinSink
+{
+public:
+  struct point
+  {
+    double x;
+    double y;
+  };
+
+  void* add_series(const std::string& msg_name, const std::string& series_name) override
+  {
+    (void)msg_name;
+    (void)series_name;
+    series.emplace_back();
+    return &series.back();
+  }
+
+  void append(void* handle, const double& time, const double& value) override
+  {
+    static_cast<std::vector<point>*>(handle)->push_back({ time, value });
+  }
+
+  // a block is appended at once, the series is sized once for the block
+  void append(void* handle, const double* times, const double* values, const size_t& count) override
+  {
+    std::vector<point>& points = *static_cast<std::vector<point>*>(handle);
+    const size_t begin = points.size();
+    points.resize(begin + count);
+    for (size_t i = 0; i < count; i++)
+    {
+      points[begin + i] = { times[i], values[i] };
+    }
+  }
+
+  // std::deque keeps the handles of all series valid
+  std::deque<std::vector<point>> series;
+};
+
+
+// peak resident set size of the process in bytes (0, if unknown)
+static uint64_t get_peak_rss(void)
+{
+  #if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if ( getrusage(RUSAGE_SELF, &usage) == 0 )
+    {
+      #ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);
+      #else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+      #endif
+    }
+  #endif
+  return 0;
+}
+
+
+// print the load profile of the last run: message types by decode time and the skipped regions
+static void print_profile(const APBinDecoder::load_report& report)
+{
+  const APBinDecoder::load_profile& profile = report.profile;
+  std::vector<APBinDecoder::message_profile> messages = profile.messages;
+  std::sort(messages.begin(), messages.end(), [](const APBinDecoder::message_profile& a, const APBinDecoder::message_profile& b)
+  {
+    return a.decode_ms > b.decode_ms || ( a.decode_ms == b.decode_ms && a.bytes > b.bytes );
+  });
+
+  std::printf("\n  %-6s %12s %12s %12s %14s %12s\n", "msg", "MB", "messages", "skipped", "outside window", "decode ms");
+  for (const auto& message : messages)
+  {
+    std::printf("  %-6s %12.2f %12" PRIu64 " %12" PRIu64 " %14" PRIu64 " %12.2f\n", message.name.c_str(),
+                static_cast<double>(message.bytes) / (1024 * 1024), message.messages, message.skipped, message.outside_window,
+                message.decode_ms);
+  }
+
+  std::printf("\n  column memory: %.1f MB allocated, %.1f MB peak\n",
+              static_cast<double>(profile.column_bytes_allocated) / (1024 * 1024),
+              static_cast<double>(profile.column_bytes_peak) / (1024 * 1024));
+  std::printf("  skipped regions: %zu%s\n", profile.skipped_regions.size() + profile.skipped_regions_dropped,
+              (profile.skipped_regions_dropped > 0) ? " (not all kept)" : "");
+  const size_t shown = std::min<size_t>(profile.skipped_regions.size(), 10);
+  for (size_t idx = 0; idx < shown; idx++)
+  {
+    const APBinDecoder::skipped_region& region = profile.skipped_regions[idx];
+    std::printf("    offset %12" PRIu64 ": %10" PRIu64 " bytes at %.3f s\n", region.offset, region.length, region.time);
+  }
+  if ( profile.skipped_regions.size() > shown )
+  {
+    std::printf("    ...\n");
+  }
+}
+
+
+static void print_usage(void)
+{
+  std::printf("usage: apbin_bench <logfile> [options]\n");
+  std::printf("  --repeat N            number of loads (default 3)\n");
+  std::printf("  --select PATTERNS     messages to decode, e.g. \"ATT IMU*\" (default all)\n");
+  std::printf("  --window START END    load only this time window (boot time in seconds)\n");
+  std::printf("  --decimate RATE       decimate messages above this rate (Hz)\n");
+  std::printf("  --threads N           number of decoding threads (default: number of hardware threads)\n");
+  std::printf("  --profile             print the load profile of the last run (message types, skipped regions, memory)\n");
+  std::printf("  --json FILE           write the report of the last run as JSON\n");
+}
+
+
+int main(int argc, char** argv)
+{
+  if ( argc < 2 || argv[1][0] == '-' )
+  {
+    print_usage();
+    return 1;
+  }
+  int repeat = 3;
+  int threads = 0;
+  bool print_load_profile = false;
+  std::string json_file;
+  APBinDecoder::selection selection;
+  for (int arg = 2; arg < argc; arg++)
+  {
+    const std::string option = argv[arg];
+    if ( option == "--repeat" && arg + 1 < argc )
+    {
+      repeat = std::atoi(argv[++arg]);
+    }
+    else if ( option == "--select" && arg + 1 < argc )
+    {
+      std::istringstream patterns(argv[++arg]);
+      selection.messages.clear();
+      for (std::string pattern; patterns >> pattern;)
+      {
+        selection.messages.push_back(pattern);
+      }
+    }
+    else if ( option == "--window" && arg + 2 < argc )
+    {
+      selection.window.enabled = true;
+      selection.window.start = std::atof(argv[++arg]);
+      selection.window.end = std::atof(argv[++arg]);
+    }
+    else if ( option == "--decimate" && arg + 1 < argc )
+    {
+      selection.decimation.enabled = true;
+      selection.decimation.max_rate = std::atof(argv[++arg]);
+    }
+    else if ( option == "--threads" && arg + 1 < argc )
+    {
+      threads = std::atoi(argv[++arg]);
+    }
+    else if ( option == "--profile" )
+    {
+      print_load_profile = true;
+    }
+    else if ( option == "--json" && arg + 1 < argc )
+    {
+      json_file = argv[++arg];
+    }
+    else
+    {
+      print_usage();
+      return 1;
+    }
+  }
+
+  MappedFile file;
+  if ( !file.open(argv[1]) || file.size() == 0 )
+  {
+    std::fprintf(stderr, "ERROR: can not open logfile %s!\n", argv[1]);
+    return 1;
+  }
+  const uint64_t len = file.size();
+  const CompressedLogfile::compression compression = CompressedLogfile::detect(file.data(), len);
+  std::printf("%s: %.1f MB%s%s\n", argv[1], static_cast<double>(len) / (1024 * 1024),
+              (compression != CompressedLogfile::compression::NONE) ? ", compressed with " : "",
+              (compression != CompressedLogfile::compression::NONE) ? CompressedLogfile::get_name(compression) : "");
+
+  APBinDecoder::load_report last_report;
+  for (int run = 1; run <= repeat; run++)
+  {
+    // every run maps the logfile again, so that the mapping is not warmed up by the previous run
+    if ( run > 1 && !file.open(argv[1]) )
+    {
+      std::fprintf(stderr, "ERROR: can not map logfile %s: %s\n", argv[1], file.get_error().c_str());
+      return 1;
+    }
+
+    APBinDecoder decoder;
+    decoder.set_selection(selection);
+    decoder.set_thread_count(threads);
+    APBinDecoder::load_hooks hooks;
+    APBinDecoder::load_report report;
+    VectorSink sink;
+
+    // a compressed logfile is decompressed while it is decoded
+    bool loaded = false;
+    if ( compression != CompressedLogfile::compression::NONE )
+    {
+      CompressedLogfile source;
+      if ( !source.open(file.data(), len) )
+      {
+        std::fprintf(stderr, "ERROR: can not decompress logfile %s: %s\n", argv[1], source.get_error().c_str());
+        return 1;
+      }
+      loaded = decoder.decode(source, sink, hooks, report);
+    }
+    else
+    {
+      loaded = decoder.decode(file.data(), len, sink, hooks, report);
+    }
+    file.close();
+    if ( !loaded )
+    {
+      std::fprintf(stderr, "ERROR: loading %s failed!\n", argv[1]);
+      return 1;
+    }
+
+    // the throughput is given for the decompressed logfile
+    const double size_mb = static_cast<double>(report.bytes) / (1024 * 1024);
+    const double total_ms = report.prescan_ms + report.decode_ms + report.postprocess_ms + report.publish_ms;
+    std::printf("run %d: %9.1f ms  %8.1f MB/s  %7.2f Mmsg/s  (pre-scan %.1f, decode %.1f, post-process %.1f, publish %.1f ms)%s%s\n",
+                run, total_ms, size_mb / (total_ms / 1000), report.msgs_read / (total_ms * 1000), report.prescan_ms,
+                report.decode_ms, report.postprocess_ms, report.publish_ms, report.parallel ? " parallel" : "",
+                report.direct_publish ? " direct" : "");
+    std::printf("       %" PRIu32 " messages read, %" PRIu32 " skipped, %" PRIu32 " outside of the window, %" PRIu64
+                " bytes skipped, %zu series\n", report.msgs_read, report.msgs_skipped, report.msgs_outside_window,
+                report.bytes_skipped, sink.series.size());
+    last_report = report;
+  }
+
+  if ( print_load_profile )
+  {
+    print_profile(last_report);
+  }
+  if ( !json_file.empty() )
+  {
+    FILE* json = std::fopen(json_file.c_str(), "w");
+    const std::string report_json = last_report.to_json();
+    if ( json == nullptr || std::fwrite(report_json.data(), 1, report_json.size(), json) != report_json.size() )
+    {
+      std::fprintf(stderr, "ERROR: can not write %s!\n", json_file.c_str());
+    }
+    if ( json != nullptr )
+    {
+      std::fclose(json);
+    }
+  }
+
+  std::printf("peak RSS: %.1f MB\n", static_cast<double>(get_peak_rss()) / (1024 * 1024));
+  return 0;
+}
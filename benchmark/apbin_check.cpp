@@ -0,0 +1,217 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Consistency check of the decoder: loads a logfile in every mode of the decoder and compares the series.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "apbin_decoder.h"
+#include "compressed_logfile.h"
+#include "mapped_file.h"
+
+
+// sink, which stores the decoded series by name
+//  - a series, which is added again, continues the stored one (the direct publish adds a series per message instance)
+class SeriesSink : public APBinSink
+{
+public:
+  struct point
+  {
+    double x;
+    double y;
+  };
+
+  void* add_series(const std::string& msg_name, const std::string& series_name) override
+  {
+    (void)msg_name;
+    return &series[series_name];
+  }
+
+  void append(void* handle, const double& time, const double& value) override
+  {
+    static_cast<std::vector<point>*>(handle)->push_back({ time, value });
+  }
+
+  void append(void* handle, const double* times, const double* values, const size_t& count) override
+  {
+    std::vector<point>& points = *static_cast<std::vector<point>*>(handle);
+    for (size_t i = 0; i < count; i++)
+    {
+      points.push_back({ times[i], values[i] });
+    }
+  }
+
+  // std::map keeps the handles of all series valid
+  std::map<std::string, std::vector<point>> series;
+};
+
+
+// compare the series of a load with the reference load, the samples are compared bitwise (NaN equals NaN)
+static bool compare(const char* mode, const bool& loaded, const SeriesSink& reference, const SeriesSink& sink)
+{
+  if ( !loaded )
+  {
+    std::fprintf(stderr, "ERROR: %s: loading failed!\n", mode);
+    std::printf("%-24s FAILED\n", mode);
+    return false;
+  }
+  bool equal = true;
+  if ( sink.series.size() != reference.series.size() )
+  {
+    std::fprintf(stderr, "ERROR: %s: %zu series instead of %zu!\n", mode, sink.series.size(), reference.series.size());
+    equal = false;
+  }
+  for (const auto& entry : reference.series)
+  {
+    const auto found = sink.series.find(entry.first);
+    if ( found == sink.series.end() )
+    {
+      std::fprintf(stderr, "ERROR: %s: series %s is missing!\n", mode, entry.first.c_str());
+      equal = false;
+      continue;
+    }
+    const std::vector<SeriesSink::point>& expected = entry.second;
+    const std::vector<SeriesSink::point>& actual = found->second;
+    if ( actual.size() != expected.size() ||
+         ( !expected.empty() && std::memcmp(actual.data(), expected.data(), expected.size() * sizeof(SeriesSink::point)) != 0 ) )
+    {
+      std::fprintf(stderr, "ERROR: %s: series %s differs (%zu instead of %zu samples)!\n", mode, entry.first.c_str(),
+                   actual.size(), expected.size());
+      equal = false;
+    }
+  }
+  std::printf("%-24s %s\n", mode, equal ? "ok" : "FAILED");
+  return equal;
+}
+
+
+// load a mapped logfile
+static bool load(const uint8_t* buf, const uint64_t& len, APBinDecoder& decoder, SeriesSink& sink)
+{
+  APBinDecoder::load_hooks hooks;
+  APBinDecoder::load_report report;
+  return decoder.decode(buf, len, sink, hooks, report);
+}
+
+
+static void print_usage(void)
+{
+  std::printf("usage: apbin_check <logfile> [compressed logfiles]\n");
+  std::printf("  loads the logfile serially, in parallel, published directly, published in chunks and resumed at\n");
+  std::printf("  several cut points and compares all series, the compressed logfiles (the same logfile compressed)\n");
+  std::printf("  are streamed, a compression without library is skipped\n");
+}
+
+
+int main(int argc, char** argv)
+{
+  if ( argc < 2 || argv[1][0] == '-' )
+  {
+    print_usage();
+    return 1;
+  }
+
+  MappedFile file;
+  if ( !file.open(argv[1]) || file.size() == 0 )
+  {
+    std::fprintf(stderr, "ERROR: can not open logfile %s!\n", argv[1]);
+    return 1;
+  }
+  const uint8_t* buf = file.data();
+  const uint64_t len = file.size();
+  bool passed = true;
+
+  // -------------------- mapped logfile -------------------- //
+  SeriesSink reference;
+  APBinDecoder serial;
+  serial.set_thread_count(1);
+  if ( !load(buf, len, serial, reference) || reference.series.empty() )
+  {
+    std::fprintf(stderr, "ERROR: loading %s failed!\n", argv[1]);
+    return 1;
+  }
+  std::printf("%-24s %zu series\n", "serial", reference.series.size());
+
+  {
+    SeriesSink sink;
+    APBinDecoder decoder;
+    decoder.set_thread_count(8);
+    APBinDecoder::load_hooks hooks;
+    APBinDecoder::load_report report;
+    const bool loaded = decoder.decode(buf, len, sink, hooks, report);
+    if ( loaded && !report.parallel )
+    {
+      std::fprintf(stderr, "ERROR: the logfile was not decoded in parallel (logfiles below 16 MiB are decoded serially)!\n");
+    }
+    passed = compare("parallel (8 threads)", loaded && report.parallel, reference, sink) && passed;
+  }
+  {
+    SeriesSink sink;
+    APBinDecoder decoder;
+    decoder.set_direct_publish(true);
+    passed = compare("direct publish", load(buf, len, decoder, sink), reference, sink) && passed;
+  }
+  {
+    SeriesSink sink;
+    APBinDecoder decoder;
+    decoder.set_publish_chunk_rows(1000);
+    passed = compare("chunked publish", load(buf, len, decoder, sink), reference, sink) && passed;
+  }
+
+  // a resume publishes all series again, the series of the load of the cut logfile are dropped
+  for (const uint64_t& cut : { len / 7, len / 2, len - len / 5 })
+  {
+    SeriesSink cut_sink;
+    SeriesSink sink;
+    APBinDecoder decoder;
+    APBinDecoder::load_report report;
+    const std::string mode = "resume at " + std::to_string(cut);
+    const bool resumed = load(buf, cut, decoder, cut_sink) && decoder.can_resume(buf, len) &&
+                         decoder.resume(buf, len, sink, report);
+    passed = compare(mode.c_str(), resumed, reference, sink) && passed;
+  }
+
+  // -------------------- compressed logfiles -------------------- //
+  for (int arg = 2; arg < argc; arg++)
+  {
+    MappedFile compressed_file;
+    if ( !compressed_file.open(argv[arg]) || compressed_file.size() == 0 )
+    {
+      std::fprintf(stderr, "ERROR: can not open logfile %s!\n", argv[arg]);
+      passed = false;
+      continue;
+    }
+    const CompressedLogfile::compression compression = CompressedLogfile::detect(compressed_file.data(), compressed_file.size());
+    const std::string mode = std::string("streamed ") +
+                             ((compression != CompressedLogfile::compression::NONE) ? CompressedLogfile::get_name(compression) : argv[arg]);
+    if ( compression != CompressedLogfile::compression::NONE && !CompressedLogfile::is_supported(compression) )
+    {
+      std::printf("%-24s skipped (not supported by this build)\n", mode.c_str());
+      continue;
+    }
+    CompressedLogfile source;
+    if ( !source.open(compressed_file.data(), compressed_file.size()) )
+    {
+      std::fprintf(stderr, "ERROR: can not decompress logfile %s: %s\n", argv[arg], source.get_error().c_str());
+      passed = false;
+      continue;
+    }
+    SeriesSink sink;
+    APBinDecoder decoder;
+    APBinDecoder::load_hooks hooks;
+    APBinDecoder::load_report report;
+    passed = compare(mode.c_str(), decoder.decode(source, sink, hooks, report), reference, sink) && passed;
+  }
+
+  return passed ? 0 : 1;
+}
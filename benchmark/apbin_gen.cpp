@@ -0,0 +1,431 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Generator of synthetic logfiles for benchmarks (deterministic for a given seed).
+ *
+ */
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+
+static constexpr uint8_t HEAD_BYTE1 = 0xA3;
+static constexpr uint8_t HEAD_BYTE2 = 0x95;
+static constexpr uint8_t LOG_FORMAT_MSG = 128;
+static constexpr uint8_t LOG_FORMAT_UNITS_MSG = 177;
+static constexpr uint8_t LOG_UNIT_MSG = 178;
+static constexpr uint8_t LOG_MULT_MSG = 179;
+
+static constexpr uint64_t START_TIME_US = 1000000;          // boot time of the first message
+static constexpr uint64_t GPS_EPOCH_MS = 1390000000000ull;  // GPS time of boot (ms since GPS epoch)
+static constexpr uint64_t WEEK_MS = 7ull * 24 * 3600 * 1000;
+static constexpr double PI = 3.14159265358979323846;
+
+
+// template of a message type
+//  - the first field is TimeUS, the field with the unit '#' is the instance number
+struct message_template
+{
+  uint8_t id;
+  const char* name;
+  const char* format;
+  const char* labels;
+  const char* units;
+  const char* multipliers;
+};
+
+static const message_template TEMPLATES[] = {
+  { 1, "GPS", "QBBIHBcLLeffB", "TimeUS,I,Status,GMS,GWk,NSats,HDop,Lat,Lng,Alt,Spd,GCrs,U", "s#-s-S-DUmnd-", "F--C---GGB---" },
+  { 2, "IMU", "QBffffffIIfBB", "TimeUS,I,GyrX,GyrY,GyrZ,AccX,AccY,AccZ,EG,EA,T,GH,AH", "s#EEEooo--O--", "F------------" },
+  { 3, "ATT", "QccccCCCC", "TimeUS,DesRoll,Roll,DesPitch,Pitch,DesYaw,Yaw,ErrRP,ErrYaw", "sdddddddd", "FBBBBBBBB" },
+  { 4, "BAT", "QBfffffcfB", "TimeUS,Inst,Volt,VoltR,Curr,CurrTot,EnrgTot,Temp,Res,RemPct", "s#vvAaJO-%", "F---------" },
+  { 5, "BARO", "QBffcf", "TimeUS,I,Alt,Press,Temp,CRt", "s#mPOn", "F---B-" },
+  { 6, "RCOU", "QHHHHHHHH", "TimeUS,C1,C2,C3,C4,C5,C6,C7,C8", "sYYYYYYYY", "F--------" },
+  { 7, "MODE", "QMBB", "TimeUS,Mode,ModeNum,Rsn", "s---", "F---" },
+  { 64, "PARM", "QNf", "TimeUS,Name,Value", "s--", "F--" },
+  { 65, "MSG", "QZ", "TimeUS,Message", "s-", "F-" },
+};
+
+static const std::pair<char, const char*> UNITS[] = {
+  { 's', "s" }, { '-', "" }, { '#', "instance" }, { 'd', "deg" }, { 'm', "m" }, { 'n', "m/s" }, { 'A', "A" },
+  { 'a', "Ah" }, { 'J', "W.s" }, { 'v', "V" }, { 'E', "rad/s" }, { 'o', "m/s/s" }, { 'O', "degC" }, { '%', "%" },
+  { 'S', "satellites" }, { 'D', "deglatitude" }, { 'U', "deglongitude" }, { 'P', "Pa" }, { 'Y', "us" },
+};
+
+static const std::pair<char, double> MULTIPLIERS[] = {
+  { '-', 0 }, { '?', 1 }, { '2', 1e2 }, { '1', 1e1 }, { '0', 1 }, { 'A', 1e-1 }, { 'B', 1e-2 }, { 'C', 1e-3 },
+  { 'D', 1e-4 }, { 'E', 1e-5 }, { 'F', 1e-6 }, { 'G', 1e-7 },
+};
+
+
+// size of a field in bytes
+static size_t get_field_size(const char& type)
+{
+  switch (type)
+  {
+    case 'b': case 'B': case 'M': return 1;
+    case 'h': case 'H': case 'c': case 'C': return 2;
+    case 'i': case 'I': case 'f': case 'e': case 'E': case 'L': case 'n': return 4;
+    case 'd': case 'q': case 'Q': return 8;
+    case 'N': return 16;
+    case 'Z': case 'a': return 64;
+    default: return 0;
+  }
+}
+
+
+static size_t get_message_length(const char* format)
+{
+  size_t length = 3;
+  for (const char* type = format; *type != '\0'; type++)
+  {
+    length += get_field_size(*type);
+  }
+  return length;
+}
+
+
+template <typename T>
+static void append_value(std::string& out, const T& value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+static void append_text(std::string& out, const std::string& text, const size_t& size)
+{
+  std::string field = text.substr(0, size);
+  field.resize(size, '\0');
+  out.append(field);
+}
+
+
+static void append_header(std::string& out, const uint8_t& msg_id)
+{
+  out.push_back(static_cast<char>(HEAD_BYTE1));
+  out.push_back(static_cast<char>(HEAD_BYTE2));
+  out.push_back(static_cast<char>(msg_id));
+}
+
+
+static void append_fmt(std::string& out, const uint8_t& msg_id, const char* name, const char* format, const char* labels)
+{
+  append_header(out, LOG_FORMAT_MSG);
+  append_value(out, msg_id);
+  append_value(out, static_cast<uint8_t>(get_message_length(format)));
+  append_text(out, name, 4);
+  append_text(out, format, 16);
+  append_text(out, labels, 64);
+}
+
+
+// append a field, the value is converted to the type of the field
+static void append_field(std::string& out, const char& type, const double& value)
+{
+  switch (type)
+  {
+    case 'b': append_value(out, static_cast<int8_t>(value)); break;
+    case 'B': case 'M': append_value(out, static_cast<uint8_t>(value)); break;
+    case 'h': case 'c': append_value(out, static_cast<int16_t>(value)); break;
+    case 'H': case 'C': append_value(out, static_cast<uint16_t>(value)); break;
+    case 'i': case 'e': case 'L': append_value(out, static_cast<int32_t>(value)); break;
+    case 'I': case 'E': append_value(out, static_cast<uint32_t>(value)); break;
+    case 'f': append_value(out, static_cast<float>(value)); break;
+    case 'd': append_value(out, value); break;
+    case 'q': append_value(out, static_cast<int64_t>(value)); break;
+    case 'Q': append_value(out, static_cast<uint64_t>(value)); break;
+    case 'n': append_text(out, "PAR", 4); break;
+    case 'N': append_text(out, "SOME_PARAM", 16); break;
+    case 'Z': case 'a': append_text(out, "synthetic message", 64); break;
+  }
+}
+
+
+// a message type of the mix with its rate and number of instances
+struct mix_entry
+{
+  const message_template* msg;
+  double rate;
+  int instances;
+};
+
+
+// next message of a message type and instance
+struct scheduled_message
+{
+  uint64_t time_us;
+  size_t mix_idx;
+  int instance;
+
+  bool operator>(const scheduled_message& other) const
+  {
+    return time_us > other.time_us || (time_us == other.time_us && mix_idx > other.mix_idx);
+  }
+};
+
+
+static void print_usage(void)
+{
+  std::printf("usage: apbin_gen <output.BIN> [options]\n");
+  std::printf("  --duration S          length of the logfile in seconds (default 600)\n");
+  std::printf("  --seed N              seed of the random values and corruptions (default 1)\n");
+  std::printf("  --corrupt P           probability of a corruption per message (default 0)\n");
+  std::printf("  --msg NAME:RATE[:N]   message type with its rate in Hz and number of instances,\n");
+  std::printf("                        replaces the default mix (IMU:1000:3 ATT:100 GPS:10:2 BAT:10 BARO:50 RCOU:50 MODE:0.1 PARM:1 MSG:0.5)\n");
+  std::printf("  message types: ");
+  for (const auto& msg : TEMPLATES)
+  {
+    std::printf("%s ", msg.name);
+  }
+  std::printf("\n");
+}
+
+
+int main(int argc, char** argv)
+{
+  if ( argc < 2 || argv[1][0] == '-' )
+  {
+    print_usage();
+    return 1;
+  }
+  const std::string output_path = argv[1];
+
+  double duration = 600;
+  uint64_t seed = 1;
+  double corrupt_probability = 0;
+  std::vector<std::string> mix_args;
+  for (int arg = 2; arg < argc; arg++)
+  {
+    const std::string option = argv[arg];
+    if ( arg + 1 >= argc )
+    {
+      print_usage();
+      return 1;
+    }
+    const std::string value = argv[++arg];
+    if ( option == "--duration" )
+    {
+      duration = std::atof(value.c_str());
+    }
+    else if ( option == "--seed" )
+    {
+      seed = std::strtoull(value.c_str(), nullptr, 10);
+    }
+    else if ( option == "--corrupt" )
+    {
+      corrupt_probability = std::atof(value.c_str());
+    }
+    else if ( option == "--msg" )
+    {
+      mix_args.push_back(value);
+    }
+    else
+    {
+      print_usage();
+      return 1;
+    }
+  }
+  if ( mix_args.empty() )
+  {
+    mix_args = { "IMU:1000:3", "ATT:100", "GPS:10:2", "BAT:10", "BARO:50", "RCOU:50", "MODE:0.1", "PARM:1", "MSG:0.5" };
+  }
+
+
+  // -------------------- message mix -------------------- //
+  std::vector<mix_entry> mix;
+  for (const std::string& mix_arg : mix_args)
+  {
+    const size_t rate_sep = mix_arg.find(':');
+    const std::string name = mix_arg.substr(0, rate_sep);
+    const std::string rate_arg = (rate_sep == std::string::npos) ? "" : mix_arg.substr(rate_sep + 1);
+    const size_t instances_sep = rate_arg.find(':');
+
+    mix_entry entry{ nullptr, std::atof(rate_arg.c_str()), 1 };
+    if ( instances_sep != std::string::npos )
+    {
+      entry.instances = std::atoi(rate_arg.c_str() + instances_sep + 1);
+    }
+    for (const auto& msg : TEMPLATES)
+    {
+      if ( name == msg.name )
+      {
+        entry.msg = &msg;
+      }
+    }
+    if ( entry.msg == nullptr || !(entry.rate > 0) || entry.instances < 1 )
+    {
+      std::fprintf(stderr, "ERROR: invalid message type '%s'!\n", mix_arg.c_str());
+      return 1;
+    }
+    if ( entry.instances > 1 && std::strchr(entry.msg->units, '#') == nullptr )
+    {
+      std::fprintf(stderr, "WARNING: message type %s has no instance field, writing a single instance!\n", entry.msg->name);
+      entry.instances = 1;
+    }
+    mix.push_back(entry);
+  }
+
+
+  // -------------------- definitions -------------------- //
+  std::string out;
+  append_fmt(out, LOG_FORMAT_MSG, "FMT", "BBnNZ", "Type,Length,Name,Format,Columns");
+  append_fmt(out, LOG_FORMAT_UNITS_MSG, "FMTU", "QBNN", "TimeUS,FmtType,UnitIds,MultIds");
+  append_fmt(out, LOG_UNIT_MSG, "UNIT", "QbZ", "TimeUS,Id,Label");
+  append_fmt(out, LOG_MULT_MSG, "MULT", "Qbd", "TimeUS,Id,Mult");
+  for (const auto& msg : TEMPLATES)
+  {
+    append_fmt(out, msg.id, msg.name, msg.format, msg.labels);
+  }
+  for (const auto& unit : UNITS)
+  {
+    append_header(out, LOG_UNIT_MSG);
+    append_value(out, START_TIME_US);
+    append_value(out, static_cast<int8_t>(unit.first));
+    append_text(out, unit.second, 64);
+  }
+  for (const auto& multiplier : MULTIPLIERS)
+  {
+    append_header(out, LOG_MULT_MSG);
+    append_value(out, START_TIME_US);
+    append_value(out, static_cast<int8_t>(multiplier.first));
+    append_value(out, multiplier.second);
+  }
+  for (const auto& msg : TEMPLATES)
+  {
+    append_header(out, LOG_FORMAT_UNITS_MSG);
+    append_value(out, START_TIME_US);
+    append_value(out, msg.id);
+    append_text(out, msg.units, 16);
+    append_text(out, msg.multipliers, 16);
+  }
+
+  std::ofstream file(output_path, std::ios::binary | std::ios::trunc);
+  if ( !file )
+  {
+    std::fprintf(stderr, "ERROR: can not write %s!\n", output_path.c_str());
+    return 1;
+  }
+
+
+  // -------------------- data messages -------------------- //
+  // all message types and instances are written in the order of their timestamps
+  std::mt19937_64 generator(seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::normal_distribution<double> noise(0.0, 0.05);
+
+  std::priority_queue<scheduled_message, std::vector<scheduled_message>, std::greater<scheduled_message>> schedule;
+  for (size_t mix_idx = 0; mix_idx < mix.size(); mix_idx++)
+  {
+    for (int instance = 0; instance < mix[mix_idx].instances; instance++)
+    {
+      schedule.push({ START_TIME_US + static_cast<uint64_t>(uniform(generator) * 1e6 / mix[mix_idx].rate), mix_idx, instance });
+    }
+  }
+
+  const uint64_t end_time_us = START_TIME_US + static_cast<uint64_t>(duration * 1e6);
+  static constexpr size_t WRITE_BLOCK_SIZE = 4 * 1024 * 1024;
+  uint64_t messages = 0;
+  uint64_t corruptions = 0;
+  uint64_t bytes_written = 0;
+  std::string msg;
+  while ( !schedule.empty() && schedule.top().time_us < end_time_us )
+  {
+    const scheduled_message next = schedule.top();
+    schedule.pop();
+    const mix_entry& entry = mix[next.mix_idx];
+    const double time = static_cast<double>(next.time_us) * 1e-6;
+
+    msg.clear();
+    append_header(msg, entry.msg->id);
+    for (size_t field = 0; entry.msg->format[field] != '\0'; field++)
+    {
+      const char& type = entry.msg->format[field];
+      double value = 0;
+      if ( field == 0 )
+      {
+        value = static_cast<double>(next.time_us);
+      }
+      else if ( entry.msg->units[field] == '#' )
+      {
+        value = next.instance;
+      }
+      else if ( std::strcmp(entry.msg->name, "GPS") == 0 && (field == 3 || field == 4) )
+      {
+        // GMS and GWk of the GPS time, so that the logfile can be time-synced
+        const uint64_t gps_ms = GPS_EPOCH_MS + next.time_us / 1000;
+        value = (field == 3) ? static_cast<double>(gps_ms % WEEK_MS) : static_cast<double>(gps_ms / WEEK_MS);
+      }
+      else
+      {
+        // slow sine wave with noise, every field and instance has its own frequency and phase
+        const double frequency = 0.01 * static_cast<double>(1 + field) * (1 + 0.1 * next.instance);
+        value = 100.0 * std::sin(2 * PI * frequency * time + field) + 100.0 * noise(generator);
+        if ( type == 'B' || type == 'H' || type == 'I' || type == 'C' || type == 'E' || type == 'M' || type == 'Q' )
+        {
+          value = std::fabs(value);
+        }
+      }
+      append_field(msg, type, value);
+    }
+    messages++;
+
+    // injected corruption: garbage in front of the message, a flipped byte or a truncated message
+    if ( corrupt_probability > 0 && uniform(generator) < corrupt_probability )
+    {
+      corruptions++;
+      const double kind = uniform(generator);
+      if ( kind < 1.0 / 3 )
+      {
+        const size_t garbage_size = 1 + generator() % 64;
+        for (size_t i = 0; i < garbage_size; i++)
+        {
+          out.push_back(static_cast<char>(generator() & 0xFF));
+        }
+      }
+      else if ( kind < 2.0 / 3 )
+      {
+        msg[generator() % msg.size()] ^= static_cast<char>(1 + generator() % 255);
+      }
+      else
+      {
+        msg.resize(generator() % msg.size());
+      }
+    }
+    out.append(msg);
+
+    schedule.push({ next.time_us + static_cast<uint64_t>(1e6 / entry.rate), next.mix_idx, next.instance });
+
+    if ( out.size() >= WRITE_BLOCK_SIZE )
+    {
+      file.write(out.data(), static_cast<std::streamsize>(out.size()));
+      bytes_written += out.size();
+      out.clear();
+    }
+  }
+  file.write(out.data(), static_cast<std::streamsize>(out.size()));
+  bytes_written += out.size();
+  file.close();
+
+  if ( !file )
+  {
+    std::fprintf(stderr, "ERROR: can not write %s!\n", output_path.c_str());
+    return 1;
+  }
+  std::printf("%s: %" PRIu64 " messages, %" PRIu64 " corruptions, %.1f MB\n", output_path.c_str(), messages, corruptions,
+              static_cast<double>(bytes_written) / (1024 * 1024));
+  return 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries streamer for Plotjuggler.
+ * Stand-in for a logger on a test bench: replays a logfile into a growing file or as blocks to a local UDP port
+ * at a given data rate, so the live streamer can be tested without hardware.
+ *
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define HAS_UDP
+#endif
+
+
+static void print_usage(void)
+{
+  std::printf("usage: apbin_replay <logfile> (--file OUTPUT | --udp PORT) [options]\n");
+  std::printf("  --file OUTPUT         append the logfile to this file (it is truncated first)\n");
+  #ifdef HAS_UDP
+    std::printf("  --udp PORT            send the logfile as datagrams to this port on localhost\n");
+  #endif
+  std::printf("  --rate KB/S           data rate of the replay (default 100)\n");
+  std::printf("  --block BYTES         bytes per write or datagram (default 1024)\n");
+}
+
+
+int main(int argc, char** argv)
+{
+  if ( argc < 2 || argv[1][0] == '-' )
+  {
+    print_usage();
+    return 1;
+  }
+
+  std::string output_path;
+  int port = 0;
+  double rate = 100;
+  size_t block_size = 1024;
+  for (int arg = 2; arg < argc; arg++)
+  {
+    const std::string option = argv[arg];
+    if ( arg + 1 >= argc )
+    {
+      print_usage();
+      return 1;
+    }
+    const std::string value = argv[++arg];
+    if ( option == "--file" )
+    {
+      output_path = value;
+    }
+    else if ( option == "--udp" )
+    {
+      port = std::atoi(value.c_str());
+    }
+    else if ( option == "--rate" )
+    {
+      rate = std::atof(value.c_str());
+    }
+    else if ( option == "--block" )
+    {
+      block_size = std::strtoull(value.c_str(), nullptr, 10);
+    }
+    else
+    {
+      print_usage();
+      return 1;
+    }
+  }
+  if ( output_path.empty() == (port == 0) || !(rate > 0) || block_size == 0 )
+  {
+    print_usage();
+    return 1;
+  }
+
+  FILE* input = std::fopen(argv[1], "rb");
+  if ( input == nullptr )
+  {
+    std::fprintf(stderr, "ERROR: can not open logfile %s!\n", argv[1]);
+    return 1;
+  }
+
+
+  // -------------------- output -------------------- //
+  FILE* output = nullptr;
+  if ( !output_path.empty() )
+  {
+    output = std::fopen(output_path.c_str(), "wb");
+    if ( output == nullptr )
+    {
+      std::fprintf(stderr, "ERROR: can not write %s!\n", output_path.c_str());
+      return 1;
+    }
+  }
+
+  #ifdef HAS_UDP
+    int udp_socket = -1;
+    sockaddr_in address{};
+    if ( port != 0 )
+    {
+      udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
+      address.sin_family = AF_INET;
+      address.sin_port = htons(static_cast<uint16_t>(port));
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+  #else
+    if ( port != 0 )
+    {
+      std::fprintf(stderr, "ERROR: UDP is not supported on this platform!\n");
+      return 1;
+    }
+  #endif
+
+
+  // -------------------- replay -------------------- //
+  // every block is written at its time of the data rate, a slow output catches up without sleeping
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<uint8_t> block(block_size);
+  uint64_t written = 0;
+  for (size_t count; (count = std::fread(block.data(), 1, block.size(), input)) > 0;)
+  {
+    if ( output != nullptr )
+    {
+      std::fwrite(block.data(), 1, count, output);
+      std::fflush(output);
+    }
+    #ifdef HAS_UDP
+      if ( udp_socket >= 0 )
+      {
+        sendto(udp_socket, block.data(), count, 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+      }
+    #endif
+    written += count;
+
+    const auto due = start + std::chrono::duration<double>(static_cast<double>(written) / (rate * 1024));
+    std::this_thread::sleep_until(std::chrono::time_point_cast<std::chrono::steady_clock::duration>(due));
+  }
+  std::printf("replayed %.1f MB in %.1f s\n", static_cast<double>(written) / (1024 * 1024),
+              std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+  std::fclose(input);
+  if ( output != nullptr )
+  {
+    std::fclose(output);
+  }
+  #ifdef HAS_UDP
+    if ( udp_socket >= 0 )
+    {
+      close(udp_socket);
+    }
+  #endif
+  return 0;
+}
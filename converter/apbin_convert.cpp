@@ -0,0 +1,431 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Batch converter of logfiles to columnar files: one table per message instance, one column per field.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "apbin_decoder.h"
+#include "compressed_logfile.h"
+#include "mapped_file.h"
+#include "table_writer.h"
+
+namespace fs = std::filesystem;
+
+
+// sink, which streams the decoded series of a logfile into one table per message instance
+//  - the table of a series is its name without the field: /IMU/#1/AccX -> table /IMU/#1 (file IMU/#1.<ext>), column AccX
+//  - the first column of every table holds the timestamps (seconds, see TIME_COLUMN)
+//  - the rows are written in chunks as soon as all columns of a table hold them, the decoder publishes message by message
+//    (direct publishing) or the stored samples in chunks of rows, so the memory of a table is bounded by the chunk size
+//  - a message, which is redefined with another layout, continues in the next part of its table: /IMU/#1 -> IMU/#1_2
+//  - a failing table cancels the load of the decoder
+class TableSink : public APBinSink
+{
+public:
+  TableSink(APBinDecoder& decoder, const fs::path& output_dir, const TableWriter::format& fmt, const size_t& chunk_rows)
+    : decoder(decoder), output_dir(output_dir), fmt(fmt), chunk_rows(chunk_rows)
+  {
+  }
+
+  void* add_series(const std::string& msg_name, const std::string& series_name) override
+  {
+    (void)msg_name;
+
+    // the unit of a field (LABEL_WITH_UNIT) is separated by a tab and may contain '/'
+    const size_t unit_pos = series_name.find('\t');
+    const std::string path = series_name.substr(0, unit_pos);
+    const size_t field_pos = path.rfind('/');
+    std::string column_name = path.substr(field_pos + 1);
+    if ( unit_pos != std::string::npos )
+    {
+      column_name += " " + series_name.substr(unit_pos + 1);
+    }
+
+    // a table, which already holds samples, is added again for a redefined message (see APBinSink)
+    const std::string table_name = path.substr(0, field_pos);
+    table*& indexed = table_index[table_name];
+    if ( indexed == nullptr || indexed->writer )
+    {
+      tables.emplace_back();
+      tables.back().name = table_name;
+      tables.back().part = (indexed == nullptr) ? 1 : indexed->part + 1;
+      tables.back().column_names.push_back(TIME_COLUMN);
+      indexed = &tables.back();
+    }
+
+    table& tbl = *indexed;
+    tbl.column_names.push_back(column_name);
+    tbl.values.emplace_back();
+    columns.push_back({ &tbl, tbl.values.size() - 1 });
+    return &columns.back();
+  }
+
+  void append(void* series, const double& time, const double& value) override
+  {
+    append(series, &time, &value, 1);
+  }
+
+  void append(void* series, const double* times, const double* values, const size_t& count) override
+  {
+    column& col = *static_cast<column*>(series);
+    table& tbl = *col.tbl;
+    if ( failed() || ( !tbl.writer && !open_table(tbl) ) )
+    {
+      return;
+    }
+
+    // all fields share the timestamps, the first column provides them
+    if ( col.index == 0 )
+    {
+      tbl.times.insert(tbl.times.end(), times, times + count);
+    }
+    tbl.values[col.index].insert(tbl.values[col.index].end(), values, values + count);
+
+    if ( tbl.times.size() >= chunk_rows )
+    {
+      flush_table(tbl, false);
+    }
+  }
+
+  // write the remaining rows of all tables and close their files
+  bool finish(void)
+  {
+    for (auto& tbl : tables)
+    {
+      if ( !tbl.writer )
+      {
+        continue;
+      }
+      if ( !failed() )
+      {
+        flush_table(tbl, true);
+      }
+      if ( !tbl.writer->close() )
+      {
+        fail(tbl.writer->get_error());
+      }
+      tbl.writer.reset();
+    }
+    return !failed();
+  }
+
+  bool failed(void) const
+  {
+    return !error.empty();
+  }
+  const std::string& get_error(void) const
+  {
+    return error;
+  }
+  size_t get_table_count(void) const
+  {
+    return tables.size();
+  }
+  uint64_t get_row_count(void) const
+  {
+    return rows_written;
+  }
+
+private:
+  static constexpr const char* TIME_COLUMN = "timestamp";
+
+  struct table
+  {
+    std::string name;
+    size_t part;    // part of the table, the first part has no suffix
+    std::vector<std::string> column_names;
+    std::vector<double> times;
+    std::vector<std::vector<double>> values;
+    std::unique_ptr<TableWriter> writer;
+  };
+  struct column
+  {
+    table* tbl;
+    size_t index;
+  };
+
+  APBinDecoder& decoder;
+  fs::path output_dir;
+  TableWriter::format fmt;
+  size_t chunk_rows;
+
+  // std::deque keeps the handles of all tables and columns valid
+  std::deque<table> tables;
+  std::map<std::string, table*> table_index;
+  std::deque<column> columns;
+
+  uint64_t rows_written = 0;
+  std::string error;
+
+
+  void fail(const std::string& message)
+  {
+    if ( error.empty() )
+    {
+      error = message;
+      decoder.cancel();
+    }
+  }
+
+  // the columns of a table are known, when its first sample is appended (see APBinSink)
+  bool open_table(table& tbl)
+  {
+    const std::string suffix = (tbl.part > 1) ? "_" + std::to_string(tbl.part) : std::string();
+    const fs::path filename = output_dir / (tbl.name.substr(1) + suffix + TableWriter::get_extension(fmt));
+    std::error_code ec;
+    fs::create_directories(filename.parent_path(), ec);
+    if ( ec )
+    {
+      fail(filename.parent_path().string() + ": " + ec.message());
+      return false;
+    }
+
+    tbl.writer = TableWriter::create(fmt);
+    if ( !tbl.writer->open(filename.string(), tbl.column_names) )
+    {
+      fail(filename.string() + ": " + tbl.writer->get_error());
+      return false;
+    }
+    return true;
+  }
+
+  // write the rows, which all columns hold, in chunks (with remainder, if final)
+  void flush_table(table& tbl, const bool& final)
+  {
+    size_t complete = tbl.times.size();
+    for (const auto& values : tbl.values)
+    {
+      complete = std::min(complete, values.size());
+    }
+
+    size_t written = 0;
+    std::vector<const double*> chunk(tbl.values.size() + 1);
+    while ( complete - written >= chunk_rows || ( final && complete > written ) )
+    {
+      const size_t rows = std::min(chunk_rows, complete - written);
+      chunk[0] = tbl.times.data() + written;
+      for (size_t idx = 0; idx < tbl.values.size(); idx++)
+      {
+        chunk[idx + 1] = tbl.values[idx].data() + written;
+      }
+      if ( !tbl.writer->write_chunk(chunk, rows) )
+      {
+        fail(tbl.name + ": " + tbl.writer->get_error());
+        return;
+      }
+      written += rows;
+      rows_written += rows;
+    }
+
+    tbl.times.erase(tbl.times.begin(), tbl.times.begin() + written);
+    for (auto& values : tbl.values)
+    {
+      values.erase(values.begin(), values.begin() + written);
+    }
+  }
+};
+
+
+// name of the output folder of a logfile: its file name without extension (and compression, e.g. 00000042.BIN.gz)
+static std::string get_logfile_stem(const std::string& logfile)
+{
+  fs::path path = fs::path(logfile).filename();
+  for (const char* extension : CompressedLogfile::get_extensions())
+  {
+    if ( path.extension() == std::string(".") + extension )
+    {
+      path = path.stem();
+      break;
+    }
+  }
+  return path.stem().string();
+}
+
+
+static void print_usage(void)
+{
+  std::printf("usage: apbin_convert [options] <logfile>...\n");
+  std::printf("  --output DIR          output folder, every logfile is written to DIR/<logfile stem>/ (default .)\n");
+  std::printf("  --format FORMAT       parquet or apcol (default parquet, if available)\n");
+  std::printf("  --jobs N              number of logfiles converted in parallel (default: number of hardware threads)\n");
+  std::printf("  --select PATTERNS     messages to convert, e.g. \"ATT IMU*\" (default all)\n");
+  std::printf("  --chunk ROWS          rows per written chunk (default 65536)\n");
+}
+
+
+int main(int argc, char** argv)
+{
+  fs::path output_dir = ".";
+  TableWriter::format fmt = TableWriter::has_parquet() ? TableWriter::format::PARQUET : TableWriter::format::APCOL;
+  int jobs = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  size_t chunk_rows = 65536;
+  APBinDecoder::selection selection;
+  std::vector<std::string> logfiles;
+  for (int arg = 1; arg < argc; arg++)
+  {
+    const std::string option = argv[arg];
+    if ( option == "--output" && arg + 1 < argc )
+    {
+      output_dir = argv[++arg];
+    }
+    else if ( option == "--format" && arg + 1 < argc )
+    {
+      const std::string name = argv[++arg];
+      if ( name == "parquet" && TableWriter::has_parquet() )
+      {
+        fmt = TableWriter::format::PARQUET;
+      }
+      else if ( name == "apcol" )
+      {
+        fmt = TableWriter::format::APCOL;
+      }
+      else
+      {
+        std::fprintf(stderr, "ERROR: format %s is not available!\n", name.c_str());
+        return 1;
+      }
+    }
+    else if ( option == "--jobs" && arg + 1 < argc )
+    {
+      jobs = std::max(1, std::atoi(argv[++arg]));
+    }
+    else if ( option == "--select" && arg + 1 < argc )
+    {
+      std::istringstream patterns(argv[++arg]);
+      selection.messages.clear();
+      for (std::string pattern; patterns >> pattern;)
+      {
+        selection.messages.push_back(pattern);
+      }
+    }
+    else if ( option == "--chunk" && arg + 1 < argc )
+    {
+      chunk_rows = std::max(1L, std::atol(argv[++arg]));
+    }
+    else if ( option.size() > 1 && option[0] == '-' )
+    {
+      print_usage();
+      return 1;
+    }
+    else
+    {
+      logfiles.push_back(option);
+    }
+  }
+  if ( logfiles.empty() )
+  {
+    print_usage();
+    return 1;
+  }
+
+  // every logfile is written into the folder of its stem, two logfiles must not share it
+  std::set<std::string> stems;
+  for (const std::string& logfile : logfiles)
+  {
+    if ( !stems.insert(get_logfile_stem(logfile)).second )
+    {
+      std::fprintf(stderr, "ERROR: more than one logfile named %s!\n", get_logfile_stem(logfile).c_str());
+      return 1;
+    }
+  }
+
+  // the logfiles are converted in parallel, each by a single thread
+  std::atomic<size_t> next_logfile{ 0 };
+  std::atomic<int> failures{ 0 };
+  std::mutex print_mutex;
+  auto convert = [&]()
+  {
+    for (size_t idx = next_logfile++; idx < logfiles.size(); idx = next_logfile++)
+    {
+      const std::string& logfile = logfiles[idx];
+      const auto start = std::chrono::steady_clock::now();
+
+      std::string error;
+      APBinDecoder decoder;
+      TableSink sink(decoder, output_dir / get_logfile_stem(logfile), fmt, chunk_rows);
+      MappedFile file;
+      CompressedLogfile compressed;
+      const bool opened = file.open(logfile);
+      const bool is_compressed = opened &&
+                                 ( CompressedLogfile::detect(file.data(), file.size()) != CompressedLogfile::compression::NONE );
+      if ( !opened )
+      {
+        error = file.get_error();
+      }
+      else if ( is_compressed && !compressed.open(file.data(), file.size()) )
+      {
+        error = compressed.get_error();
+      }
+      else
+      {
+        // direct publishing streams the samples into the tables without building the messages_store
+        //  - logfiles with redefined messages are stored by the decoder, the tables receive chunks of rows then
+        decoder.set_selection(selection);
+        decoder.set_thread_count(1);
+        decoder.set_direct_publish(true);
+        decoder.set_publish_chunk_rows(chunk_rows);
+
+        APBinDecoder::load_hooks hooks;
+        APBinDecoder::load_report report;
+        if ( is_compressed )
+        {
+          decoder.decode(compressed, sink, hooks, report);
+        }
+        else
+        {
+          decoder.decode(file.data(), file.size(), sink, hooks, report);
+        }
+        file.close();
+
+        if ( !sink.finish() )
+        {
+          error = sink.get_error();
+        }
+      }
+
+      const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      std::lock_guard<std::mutex> lock(print_mutex);
+      if ( !error.empty() )
+      {
+        std::fprintf(stderr, "ERROR: converting %s failed: %s\n", logfile.c_str(), error.c_str());
+        failures++;
+        continue;
+      }
+      std::printf("%s: %zu tables, %" PRIu64 " rows in %.1f ms\n", logfile.c_str(), sink.get_table_count(),
+                  sink.get_row_count(), elapsed_ms);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int worker = 0; worker < std::min(jobs, static_cast<int>(logfiles.size())); worker++)
+  {
+    workers.emplace_back(convert);
+  }
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,263 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Writers of the columnar tables of the batch converter (see table_writer.h).
+ *
+ */
+
+#include "table_writer.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef WITH_PARQUET
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/util/compression.h>
+#include <parquet/arrow/writer.h>
+#endif
+
+
+#ifdef WITH_PARQUET
+// writer of Apache Parquet files, every chunk is written as a row group
+class ParquetWriter : public TableWriter
+{
+public:
+  ~ParquetWriter() override
+  {
+    close();
+  }
+
+  bool open(const std::string& filename, const std::vector<std::string>& columns) override
+  {
+    arrow::FieldVector fields;
+    for (const std::string& column : columns)
+    {
+      fields.push_back(arrow::field(column, arrow::float64(), false));
+    }
+    schema = arrow::schema(fields);
+
+    auto file_result = arrow::io::FileOutputStream::Open(filename);
+    if ( !file_result.ok() )
+    {
+      error = file_result.status().ToString();
+      return false;
+    }
+    file = *file_result;
+
+    // zstd compresses the slowly changing columns of a logfile well, if arrow was built with it
+    parquet::WriterProperties::Builder properties;
+    if ( arrow::util::Codec::IsAvailable(arrow::Compression::ZSTD) )
+    {
+      properties.compression(parquet::Compression::ZSTD);
+    }
+
+    auto writer_result = parquet::arrow::FileWriter::Open(*schema, arrow::default_memory_pool(), file, properties.build());
+    if ( !writer_result.ok() )
+    {
+      error = writer_result.status().ToString();
+      return false;
+    }
+    writer = std::move(*writer_result);
+    return true;
+  }
+
+  bool write_chunk(const std::vector<const double*>& columns, const size_t& rows) override
+  {
+    std::vector<std::shared_ptr<arrow::Array>> arrays;
+    for (const double* values : columns)
+    {
+      arrow::DoubleBuilder builder;
+      std::shared_ptr<arrow::Array> array;
+      arrow::Status status = builder.AppendValues(values, static_cast<int64_t>(rows));
+      if ( status.ok() )
+      {
+        status = builder.Finish(&array);
+      }
+      if ( !status.ok() )
+      {
+        error = status.ToString();
+        return false;
+      }
+      arrays.push_back(array);
+    }
+
+    const std::shared_ptr<arrow::Table> table = arrow::Table::Make(schema, arrays, static_cast<int64_t>(rows));
+    const arrow::Status status = writer->WriteTable(*table, static_cast<int64_t>(rows));
+    if ( !status.ok() )
+    {
+      error = status.ToString();
+      return false;
+    }
+    return true;
+  }
+
+  bool close(void) override
+  {
+    bool closed = true;
+    if ( writer )
+    {
+      const arrow::Status status = writer->Close();
+      closed = status.ok();
+      error = closed ? error : status.ToString();
+      writer.reset();
+    }
+    if ( file )
+    {
+      const arrow::Status status = file->Close();
+      closed = closed && status.ok();
+      error = status.ok() ? error : status.ToString();
+      file.reset();
+    }
+    return closed;
+  }
+
+private:
+  std::shared_ptr<arrow::Schema> schema;
+  std::shared_ptr<arrow::io::FileOutputStream> file;
+  std::unique_ptr<parquet::arrow::FileWriter> writer;
+};
+#endif
+
+
+
+const char* TableWriter::get_extension(const format& fmt)
+{
+  switch (fmt)
+  {
+    case format::PARQUET:
+      return ".parquet";
+    case format::APCOL:
+    default:
+      return ".apcol";
+  }
+}
+
+
+
+bool TableWriter::has_parquet(void)
+{
+  #ifdef WITH_PARQUET
+    return true;
+  #else
+    return false;
+  #endif
+}
+
+
+
+std::unique_ptr<TableWriter> TableWriter::create(const format& fmt)
+{
+  switch (fmt)
+  {
+    case format::PARQUET:
+      #ifdef WITH_PARQUET
+        return std::unique_ptr<TableWriter>(new ParquetWriter());
+      #else
+        return nullptr;
+      #endif
+    case format::APCOL:
+    default:
+      return std::unique_ptr<TableWriter>(new ApcolWriter());
+  }
+}
+
+
+
+ApcolWriter::~ApcolWriter()
+{
+  if ( file != nullptr )
+  {
+    std::fclose(file);
+  }
+}
+
+
+
+bool ApcolWriter::open(const std::string& filename, const std::vector<std::string>& columns)
+{
+  file = std::fopen(filename.c_str(), "wb");
+  if ( file == nullptr )
+  {
+    error = std::strerror(errno);
+    return false;
+  }
+
+  static constexpr char MAGIC[8] = { 'A', 'P', 'B', 'C', 'O', 'L', 'S', '1' };
+  column_count = columns.size();
+  const uint32_t count = static_cast<uint32_t>(column_count);
+  if ( !write(MAGIC, sizeof(MAGIC)) || !write(&count, sizeof(count)) )
+  {
+    return false;
+  }
+  for (const std::string& column : columns)
+  {
+    const uint32_t length = static_cast<uint32_t>(column.size());
+    if ( !write(&length, sizeof(length)) || !write(column.data(), column.size()) )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+
+bool ApcolWriter::write_chunk(const std::vector<const double*>& columns, const size_t& rows)
+{
+  if ( rows == 0 )
+  {
+    return true;
+  }
+
+  const uint64_t count = rows;
+  if ( !write(&count, sizeof(count)) )
+  {
+    return false;
+  }
+  for (size_t column = 0; column < column_count; column++)
+  {
+    if ( !write(columns[column], rows * sizeof(double)) )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+
+bool ApcolWriter::close(void)
+{
+  if ( file == nullptr )
+  {
+    return true;
+  }
+
+  // the end marker
+  const uint64_t count = 0;
+  bool closed = write(&count, sizeof(count));
+  if ( std::fclose(file) != 0 && closed )
+  {
+    error = std::strerror(errno);
+    closed = false;
+  }
+  file = nullptr;
+  return closed;
+}
+
+
+
+bool ApcolWriter::write(const void* data, const size_t& size)
+{
+  if ( std::fwrite(data, 1, size, file) != size )
+  {
+    error = std::strerror(errno);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file
+ * @author Pierre Kancir <pierre.kancir.emn@gmail.com>
+ * @author Jonas Withelm <IAV GmbH>
+ *
+ * @section DESCRIPTION
+ *
+ * ArduPilot DataFlash binaries loader for Plotjuggler.
+ * Writers of the columnar tables of the batch converter (one table per message instance).
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// writer of a table with float64 columns, which is written in chunks of rows
+//  - open is called once with the names of all columns, followed by any number of write_chunk calls
+//  - all methods return false on failure (see get_error)
+class TableWriter
+{
+public:
+  enum class format : uint8_t
+  {
+    PARQUET,  // Apache Parquet (only with Arrow/Parquet, see has_parquet)
+    APCOL     // chunked float64 columns without any dependency (see ApcolWriter)
+  };
+
+  virtual ~TableWriter() = default;
+
+  virtual bool open(const std::string& filename, const std::vector<std::string>& columns) = 0;
+
+  // write the given number of rows, columns holds a pointer to the values of each column
+  virtual bool write_chunk(const std::vector<const double*>& columns, const size_t& rows) = 0;
+
+  virtual bool close(void) = 0;
+
+  const std::string& get_error(void) const
+  {
+    return error;
+  }
+
+  // file extension of a format
+  static const char* get_extension(const format& fmt);
+
+  // indicator, if the converter was built with Arrow/Parquet
+  static bool has_parquet(void);
+
+  // create a writer of the given format (nullptr, if the format is not available)
+  static std::unique_ptr<TableWriter> create(const format& fmt);
+
+protected:
+  std::string error;
+};
+
+
+// writer of the apcol format, a minimal columnar format without any dependency
+//  (all values in the byte order of the host, which is little-endian on all supported platforms):
+//  - magic "APBCOLS1" (8 bytes), number of columns (uint32)
+//  - for each column: length of the name (uint32), name (UTF-8)
+//  - chunks: number of rows (uint64, > 0), followed by the values of each column (rows * float64)
+//  - a chunk with 0 rows ends the table (a missing end marks a truncated file)
+class ApcolWriter : public TableWriter
+{
+public:
+  ~ApcolWriter() override;
+
+  bool open(const std::string& filename, const std::vector<std::string>& columns) override;
+  bool write_chunk(const std::vector<const double*>& columns, const size_t& rows) override;
+  bool close(void) override;
+
+private:
+  std::FILE* file = nullptr;
+  size_t column_count = 0;
+
+  bool write(const void* data, const size_t& size);
+};